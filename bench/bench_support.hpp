@@ -0,0 +1,22 @@
+#ifndef DATATRANSFER_BENCH_SUPPORT_HPP
+#define DATATRANSFER_BENCH_SUPPORT_HPP
+
+#include <algorithm>
+#include <chrono>
+
+// Seconds taken by the fastest of repeats calls to run()
+template <typename function>
+double bestOf(int repeats, function run)
+{
+    double best = 1e9;
+    for (int i = 0; i < repeats; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    return best;
+}
+
+#endif // DATATRANSFER_BENCH_SUPPORT_HPP
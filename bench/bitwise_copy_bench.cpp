@@ -0,0 +1,98 @@
+// Send cost of messages serialized field by field against the same
+// layouts bulk copied as bitwise serializable types
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "bench_support.hpp"
+
+namespace {
+
+struct samples
+{
+    float v[60];
+
+    template <typename P>
+    void method(P& p) { p % v; }
+};
+
+struct fields
+{
+    float a, b, c, d, e, f, g, h;
+
+    template <typename P>
+    void method(P& p) { p % a; p % b; p % c; p % d; p % e; p % f; p % g; p % h; }
+};
+
+struct bitwise_samples : samples {};
+struct bitwise_fields : fields {};
+
+}
+
+namespace datatransfer {
+template <> struct is_bitwise_serializable<bitwise_samples> : std::true_type {};
+template <> struct is_bitwise_serializable<bitwise_fields> : std::true_type {};
+}
+
+namespace {
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 4;
+    static constexpr int MAX_MESSAGE_SIZE = 240;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    template <int N, int = 0> struct data;
+
+    template <int dummy> struct data<1, dummy> { using type = samples; static const int length = 1; };
+    template <int dummy> struct data<2, dummy> { using type = bitwise_samples; static const int length = 1; };
+    template <int dummy> struct data<3, dummy> { using type = fields; static const int length = 1; };
+    template <int dummy> struct data<4, dummy> { using type = bitwise_fields; static const int length = 1; };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, datatransfer::callback_handler<protocol>>;
+
+template <int T, typename message>
+double nsPerSend(message& m)
+{
+    const int sends = 20000;
+
+    const double seconds = bestOf(9, [&]
+    {
+        std::stringstream out;
+        connector c(out);
+        for (int i = 0; i < sends; ++i)
+            c.send<T>(m);
+    });
+
+    return seconds * 1e9 / sends;
+}
+
+}
+
+int main()
+{
+    bitwise_samples s;
+    for (int i = 0; i < 60; ++i)
+        s.v[i] = float(i);
+    bitwise_fields f = {};
+
+    std::cout << "60 float array:  per field " << nsPerSend<1>(static_cast<samples&>(s)) << " ns, bitwise "
+              << nsPerSend<2>(s) << " ns\n";
+    std::cout << "8 float struct:  per field " << nsPerSend<3>(static_cast<fields&>(f)) << " ns, bitwise "
+              << nsPerSend<4>(f) << " ns\n";
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Checksum throughput over a 64 KiB buffer, with a 1 MiB memcpy for scale
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <datatransfer/crc.hpp>
+#include "bench_support.hpp"
+
+using datatransfer::crc16_ccitt;
+using datatransfer::crc32c;
+
+namespace {
+
+volatile uint32_t sink;
+
+template <typename function>
+double gigabytesPerSecond(size_t bytes, function run)
+{
+    const int passes = 200;
+
+    const double seconds = bestOf(9, [&]
+    {
+        for (int i = 0; i < passes; ++i)
+            run();
+    });
+
+    return bytes * double(passes) / seconds / 1e9;
+}
+
+}
+
+int main()
+{
+    std::vector<uint8_t> buffer(65536);
+    std::vector<uint8_t> source(1 << 20);
+    std::vector<uint8_t> destination(1 << 20);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = uint8_t(i * 131);
+
+    std::cout << "xor8       " << gigabytesPerSecond(buffer.size(), [&]
+    {
+        uint8_t x = 0;
+        for (uint8_t b : buffer)
+            x ^= b;
+        sink = x;
+    }) << " GB/s\n";
+
+    std::cout << "crc16      " << gigabytesPerSecond(buffer.size(), [&]
+    {
+        sink = crc16_ccitt::update(crc16_ccitt::INITIAL, buffer.data(), buffer.size());
+    }) << " GB/s\n";
+
+    std::cout << "crc32c sw  " << gigabytesPerSecond(buffer.size(), [&]
+    {
+        sink = crc32c::update_portable(crc32c::INITIAL, buffer.data(), buffer.size());
+    }) << " GB/s\n";
+
+    std::cout << "crc32c     " << gigabytesPerSecond(buffer.size(), [&]
+    {
+        sink = crc32c::update(crc32c::INITIAL, buffer.data(), buffer.size());
+    }) << " GB/s\n";
+
+    std::cout << "memcpy 1M  " << gigabytesPerSecond(source.size(), [&]
+    {
+        memcpy(destination.data(), source.data(), source.size());
+        sink = destination[7];
+    }) << " GB/s\n";
+
+    return 0;
+}
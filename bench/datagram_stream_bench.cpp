@@ -0,0 +1,148 @@
+// Small telemetry frames over UDP loopback with sender and receiver on one
+// thread, so the rate is what a single core sustains for both ends: single
+// sends flushed every 64 datagrams, then batches packing whole datagrams
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/datagram_stream.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "bench_support.hpp"
+
+namespace {
+
+struct telemetry
+{
+    uint32_t id;
+    uint16_t value;
+    uint8_t flags;
+
+    template <typename P>
+    void method(P& p) { p % id; p % value; p % flags; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = telemetry;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using stream = datatransfer::datagram_stream<>;
+using connector = datatransfer::p2p_connector<std::mutex, stream, protocol, datatransfer::callback_handler<protocol>, 1472>;
+
+uint64_t received;
+
+void onTelemetry(const telemetry&)
+{
+    ++received;
+}
+
+// Two UDP sockets on 127.0.0.1 connected to each other
+bool loopbackPair(int fds[2])
+{
+    sockaddr_in addresses[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        sockaddr_in any = {};
+        any.sin_family = AF_INET;
+        any.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addresses[i]);
+
+        fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fds[i] < 0 || bind(fds[i], reinterpret_cast<sockaddr*>(&any), sizeof(any)) != 0 ||
+            getsockname(fds[i], reinterpret_cast<sockaddr*>(&addresses[i]), &length) != 0)
+            return false;
+    }
+
+    return connect(fds[0], reinterpret_cast<sockaddr*>(&addresses[1]), sizeof(addresses[1])) == 0 &&
+           connect(fds[1], reinterpret_cast<sockaddr*>(&addresses[0]), sizeof(addresses[0])) == 0;
+}
+
+// Reads until every frame sent so far has arrived; loopback does not drop
+// while the receive buffer keeps up with one round
+void drain(connector& rx, uint64_t sent)
+{
+    while (received < sent)
+        rx.readDatagrams(true);
+}
+
+}
+
+int main()
+{
+    const uint64_t frames = 4000000;
+
+    int fds[2];
+    if (!loopbackPair(fds))
+    {
+        std::cerr << "cannot set up UDP loopback sockets\n";
+        return 1;
+    }
+
+    stream tx_stream(fds[0]);
+    stream rx_stream(fds[1]);
+    connector tx(tx_stream);
+    connector rx(rx_stream);
+    rx.registerMessageHandler<1>(&onTelemetry);
+
+    telemetry t = { 1, 2, 3 };
+
+    const double single = bestOf(3, [&]
+    {
+        received = 0;
+        for (uint64_t i = 0; i < frames; i += 64)
+        {
+            for (int k = 0; k < 64; ++k)
+                tx.send<1>(t);
+            tx.flush();
+            drain(rx, i + 64);
+        }
+    });
+
+    // One round roughly fills the 64 datagram queue with full datagrams
+    const uint64_t round = 64 * (1472 / 16);
+    const uint64_t batched_frames = frames / round * round;
+    const double batched = bestOf(3, [&]
+    {
+        received = 0;
+        for (uint64_t i = 0; i < batched_frames; i += round)
+        {
+            {
+                auto batch = tx.beginBatch();
+                for (uint64_t k = 0; k < round; ++k)
+                    batch.send<1>(t);
+            }
+            tx.flush();
+            drain(rx, i + round);
+        }
+    });
+
+    std::cout << "send(), 1 frame/datagram: " << frames / single / 1e6 << " M msg/s\n";
+    std::cout << "batch, full datagrams:    " << batched_frames / batched / 1e6 << " M msg/s\n";
+
+    close(fds[0]);
+    close(fds[1]);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Wire bytes and cost of a periodic state message, full frames against
+// delta mode with two keyframe intervals
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/packet_types.h>
+
+namespace {
+
+// 16 fields; per frame the timestamp, position and a counter change
+struct state
+{
+    uint64_t t;
+    float x, y, z;
+    float roll, pitch, yaw;
+    float vx, vy, vz;
+    uint32_t counter;
+    uint16_t mode;
+    uint16_t faults;
+    float battery;
+    float temp;
+    uint32_t errors;
+
+    template <typename P>
+    void method(P& p)
+    {
+        p % t; p % x; p % y; p % z; p % roll; p % pitch; p % yaw; p % vx; p % vy; p % vz;
+        p % counter; p % mode; p % faults; p % battery; p % temp; p % errors;
+    }
+};
+
+template <int interval>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 128;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    using header_type = datatransfer::length_packet_header;
+
+    template <int N>
+    struct data
+    {
+        using type = state;
+        static const int length = 1;
+        static const int keyframe_interval = interval;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::crc16_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+size_t delivered;
+
+void onState(const state&)
+{
+    ++delivered;
+}
+
+template <int interval>
+void run(const char* name)
+{
+    using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<interval>,
+                                                  datatransfer::callback_handler<protocol<interval>>>;
+    const int messages = 100000;
+
+    std::stringstream out;
+    connector tx(out);
+    state s = {};
+    s.mode = 3;
+    s.battery = 12.5f;
+    s.temp = 40.0f;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < messages; ++i)
+    {
+        s.t = uint64_t(i) * 10000;
+        s.x += 0.01f;
+        s.y -= 0.02f;
+        s.counter = uint32_t(i);
+        tx.template send<1>(s);
+    }
+    const double send_time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    const std::string wire = out.str();
+
+    std::stringstream unused;
+    connector rx(unused);
+    rx.template registerMessageHandler<1>(&onState);
+    delivered = 0;
+
+    start = std::chrono::steady_clock::now();
+    rx.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+    const double receive_time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << ": " << double(wire.size()) / messages << " B/frame, send " << send_time / messages
+              << " ns, receive " << receive_time / messages << " ns, delivered " << delivered << "\n";
+}
+
+}
+
+int main()
+{
+    run<0>("full frames         ");
+    run<100>("delta, keyframe 100 ");
+    run<10>("delta, keyframe 10  ");
+
+    return 0;
+}
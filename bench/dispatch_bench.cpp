@@ -0,0 +1,90 @@
+// Receive cost per frame as the message set grows; with the per-id
+// operation table it should not depend on NUMBER_OF_MESSAGES
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "bench_support.hpp"
+
+namespace {
+
+struct small
+{
+    uint32_t a;
+
+    template <typename P>
+    void method(P& p) { p % a; }
+};
+
+template <int count>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = count;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    template <int N>
+    struct data
+    {
+        using type = small;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+volatile uint32_t sink;
+
+void onSmall(const small& s)
+{
+    sink = sink + s.a;
+}
+
+// Frames use the highest id, the last one a linear search would reach
+template <int count>
+void run()
+{
+    using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<count>,
+                                                  datatransfer::callback_handler<protocol<count>>>;
+    const int frames = 1000;
+    const int passes = 200;
+
+    std::stringstream out;
+    connector c(out);
+    small s = { 1 };
+    for (int i = 0; i < frames; ++i)
+        c.template send<count>(s);
+    const std::string wire = out.str();
+
+    c.template registerMessageHandler<count>(&onSmall);
+    const double seconds = bestOf(7, [&]
+    {
+        for (int i = 0; i < passes; ++i)
+            c.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+    });
+
+    std::cout << count << " messages: " << seconds * 1e9 / (double(frames) * passes) << " ns/frame\n";
+}
+
+}
+
+int main()
+{
+    run<8>();
+    run<64>();
+    run<128>();
+    run<255>();
+
+    return 0;
+}
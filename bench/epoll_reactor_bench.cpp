@@ -0,0 +1,144 @@
+// epoll_reactor throughput with 1, 16 and 256 connectors over socketpairs,
+// sent one frame per send() and in batches of 64
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/epoll_reactor.hpp>
+#include <datatransfer/fd_stream.hpp>
+#include <datatransfer/p2p_connector.hpp>
+
+using datatransfer::epoll_reactor;
+using datatransfer::fd_stream;
+
+namespace {
+
+struct telemetry
+{
+    uint32_t id;
+    uint16_t value;
+    uint8_t flags;
+
+    template <typename P>
+    void method(P& p) { p % id; p % value; p % flags; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = telemetry;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, fd_stream, protocol, datatransfer::callback_handler<protocol>>;
+
+std::atomic<size_t> received(0);
+
+void onTelemetry(const telemetry&)
+{
+    received.fetch_add(1, std::memory_order_relaxed);
+}
+
+void run(int links, bool batched)
+{
+    const size_t per_link = (batched ? 4000000 : 1000000) / links;
+    const size_t total = per_link * links;
+    received = 0;
+
+    std::vector<int> fds;
+    std::vector<std::unique_ptr<fd_stream>> streams;
+    std::vector<std::unique_ptr<connector>> senders;
+    std::vector<std::unique_ptr<connector>> receivers;
+    epoll_reactor reactor;
+
+    for (int i = 0; i < links; ++i)
+    {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+            return;
+
+        fds.push_back(pair[0]);
+        fds.push_back(pair[1]);
+        streams.emplace_back(new fd_stream(pair[0]));
+        senders.emplace_back(new connector(*streams.back()));
+        streams.emplace_back(new fd_stream(pair[1]));
+        receivers.emplace_back(new connector(*streams.back()));
+        receivers.back()->registerMessageHandler<1>(&onTelemetry);
+        reactor.add(pair[1], *receivers.back());
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::thread loop([&]
+    {
+        while (received.load(std::memory_order_relaxed) < total)
+            reactor.runOnce(10);
+    });
+
+    telemetry t = { 1, 2, 3 };
+    for (size_t sent = 0; sent < per_link; sent += 64)
+    {
+        for (int i = 0; i < links; ++i)
+        {
+            if (batched)
+            {
+                auto batch = senders[i]->beginBatch();
+                for (size_t k = 0; k < 64 && sent + k < per_link; ++k)
+                    batch.send<1>(t);
+            }
+            else
+            {
+                for (size_t k = 0; k < 64 && sent + k < per_link; ++k)
+                    senders[i]->send<1>(t);
+            }
+        }
+    }
+    loop.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << (batched ? "batched " : "single  ") << links << " connectors: " << total / seconds / 1e6 << " M msg/s\n";
+
+    for (size_t i = 0; i < fds.size(); ++i)
+    {
+        if (i % 2 == 1)
+            reactor.remove(fds[i]);
+        close(fds[i]);
+    }
+}
+
+}
+
+int main()
+{
+    for (int batched = 0; batched < 2; ++batched)
+    {
+        run(1, batched != 0);
+        run(16, batched != 0);
+        run(256, batched != 0);
+    }
+
+    return 0;
+}
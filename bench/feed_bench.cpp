@@ -0,0 +1,89 @@
+// Parse throughput of read() from a stream against feed() from memory
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "bench_support.hpp"
+
+namespace {
+
+struct samples
+{
+    uint8_t v[240];
+
+    template <typename P>
+    void method(P& p) { p % v; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 240;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = samples;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, datatransfer::callback_handler<protocol>>;
+
+volatile size_t sink;
+
+void onSamples(const samples& s)
+{
+    sink = sink + s.v[0] + 1;
+}
+
+}
+
+int main()
+{
+    const int frames = 20000;
+
+    std::stringstream out;
+    connector tx(out);
+    samples s;
+    for (int i = 0; i < 240; ++i)
+        s.v[i] = uint8_t(i * 37);
+    for (int i = 0; i < frames; ++i)
+        tx.send<1>(s);
+    const std::string wire = out.str();
+
+    const double read_time = bestOf(5, [&]
+    {
+        std::stringstream in(wire);
+        connector rx(in);
+        rx.registerMessageHandler<1>(&onSamples);
+        rx.read();
+    });
+
+    std::stringstream unused;
+    connector fed(unused);
+    fed.registerMessageHandler<1>(&onSamples);
+    const double feed_time = bestOf(5, [&]
+    {
+        fed.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+    });
+
+    std::cout << "read() from stringstream: " << wire.size() / read_time / 1e9 << " GB/s\n";
+    std::cout << "feed() from memory:       " << wire.size() / feed_time / 1e9 << " GB/s\n";
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Receive cost of a 240 byte message decoded field by field against the
+// same layout received in place as a bitwise serializable type
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "bench_support.hpp"
+
+namespace {
+
+struct samples
+{
+    float v[60];
+
+    template <typename P>
+    void method(P& p) { p % v; }
+};
+
+struct bitwise_samples : samples {};
+
+}
+
+namespace datatransfer {
+template <> struct is_bitwise_serializable<bitwise_samples> : std::true_type {};
+}
+
+namespace {
+
+template <typename message>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 256;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = message;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+volatile float sink;
+
+template <typename message>
+void onSamples(const message& s)
+{
+    sink = sink + s.v[59];
+}
+
+template <typename message>
+double nsPerFrame()
+{
+    using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<message>,
+                                                  datatransfer::callback_handler<protocol<message>>>;
+    const int frames = 1000;
+    const int passes = 100;
+
+    std::stringstream out;
+    connector c(out);
+    message s;
+    for (int i = 0; i < 60; ++i)
+        s.v[i] = float(i);
+    for (int i = 0; i < frames; ++i)
+        c.template send<1>(s);
+    const std::string wire = out.str();
+
+    c.template registerMessageHandler<1>(&onSamples<message>);
+    const double seconds = bestOf(9, [&]
+    {
+        for (int i = 0; i < passes; ++i)
+            c.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+    });
+
+    return seconds * 1e9 / (double(frames) * passes);
+}
+
+}
+
+int main()
+{
+    const double per_field = nsPerFrame<samples>();
+    const double in_place = nsPerFrame<bitwise_samples>();
+
+    std::cout << "per field: " << per_field << " ns/frame, " << 240 / per_field << " GB/s payload\n";
+    std::cout << "in place:  " << in_place << " ns/frame, " << 240 / in_place << " GB/s payload\n";
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Per-signal dispatch cost of the handler types: a plain function pointer,
+// std::function and inplace_function, plus the cost of registering a
+// handler whose captures are too large for std::function's small buffer
+#include <cstdint>
+#include <iostream>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/inplace_callback_handler.hpp>
+#include <datatransfer/std_function_callback_handler.hpp>
+#include "bench_support.hpp"
+
+namespace {
+
+struct sample
+{
+    uint32_t value;
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+
+    template <int N>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+};
+
+const int signals = 10000000;
+const int registrations = 1000000;
+
+uint64_t total;
+volatile uint64_t sink;
+
+void onSample(const sample& s)
+{
+    total += s.value;
+}
+
+template <typename handler>
+double nanosecondsPerSignal(handler& h)
+{
+    return bestOf(5, [&]
+    {
+        for (int i = 0; i < signals; ++i)
+        {
+            sample s = { uint32_t(i) };
+            h.template signal<1>(s);
+        }
+    }) * 1e9 / signals;
+}
+
+// Four pointers of captures, past the usual std::function inline storage
+template <typename handler>
+double nanosecondsPerRegistration(handler& h)
+{
+    uint64_t a = 0, b = 0, c = 0, d = 0;
+    return bestOf(5, [&]
+    {
+        for (int i = 0; i < registrations; ++i)
+            h.template registerHandler<1>([&a, &b, &c, &d](const sample& s) { a += s.value; b += a; c += b; d += c; });
+    }) * 1e9 / registrations;
+}
+
+}
+
+int main()
+{
+    datatransfer::callback_handler<protocol> pointer;
+    datatransfer::std_function_callback_handler<protocol> function;
+    datatransfer::inplace_callback_handler<protocol> inplace;
+
+    pointer.registerHandler<1>(&onSample);
+    function.registerHandler<1>([](const sample& s) { total += s.value; });
+    inplace.registerHandler<1>([](const sample& s) { total += s.value; });
+
+    std::cout << "signal, callback_handler:              " << nanosecondsPerSignal(pointer) << " ns\n";
+    std::cout << "signal, std_function_callback_handler: " << nanosecondsPerSignal(function) << " ns\n";
+    std::cout << "signal, inplace_callback_handler:      " << nanosecondsPerSignal(inplace) << " ns\n";
+
+    std::cout << "register, std_function_callback_handler: " << nanosecondsPerRegistration(function) << " ns\n";
+    std::cout << "register, inplace_callback_handler:      " << nanosecondsPerRegistration(inplace) << " ns\n";
+
+    sink = total;
+    return 0;
+}
@@ -0,0 +1,101 @@
+// lz_codec compression and decompression throughput and ratio on frame
+// sized blocks of typical payloads
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <datatransfer/lz_codec.hpp>
+#include "bench_support.hpp"
+
+namespace {
+
+using codec = datatransfer::lz_codec<>;
+
+const size_t total = 4 << 20;
+
+// Telemetry records: a slowly changing counter and sensor values
+std::vector<uint8_t> telemetry()
+{
+    std::vector<uint8_t> data;
+    std::mt19937 random(1);
+    for (uint32_t i = 0; data.size() < total; ++i)
+    {
+        const int16_t value = int16_t(1000 + random() % 16);
+        const uint8_t record[] = { 0x01, 0x00, uint8_t(i), uint8_t(i >> 8), uint8_t(value), uint8_t(value >> 8),
+                                   0x00, 0x00, 0x80, 0x3F, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x07 };
+        data.insert(data.end(), record, record + sizeof(record));
+    }
+
+    return data;
+}
+
+std::vector<uint8_t> text()
+{
+    std::vector<uint8_t> data;
+    std::mt19937 random(2);
+    const char* const words[] = { "\"position\": ", "\"velocity\": ", "\"status\": \"ok\", ", "{", "}, ", "[", "], " };
+    while (data.size() < total)
+    {
+        const std::string word = words[random() % 7] + std::to_string(random() % 1000);
+        data.insert(data.end(), word.begin(), word.end());
+    }
+
+    return data;
+}
+
+std::vector<uint8_t> noise()
+{
+    std::vector<uint8_t> data(total);
+    std::mt19937 random(3);
+    for (auto& byte : data)
+        byte = uint8_t(random());
+
+    return data;
+}
+
+void run(const char* name, const std::vector<uint8_t>& data, size_t block)
+{
+    const size_t blocks = data.size() / block;
+    std::vector<uint8_t> packed(blocks * (block + block / 255 + 16));
+    std::vector<size_t> sizes(blocks);
+    std::vector<uint8_t> out(block);
+    const size_t stride = packed.size() / blocks;
+
+    size_t packed_total = 0;
+    const double compress = bestOf(3, [&]
+    {
+        packed_total = 0;
+        for (size_t i = 0; i < blocks; ++i)
+        {
+            sizes[i] = codec::compress(data.data() + i * block, block, packed.data() + i * stride, stride);
+            packed_total += sizes[i];
+        }
+    });
+
+    const double decompress = bestOf(3, [&]
+    {
+        for (size_t i = 0; i < blocks; ++i)
+            codec::decompress(packed.data() + i * stride, sizes[i], out.data(), out.size());
+    });
+
+    const double bytes = double(blocks * block);
+    std::printf("%-10s %5zu B blocks: ratio %.2f, compress %6.0f MB/s, decompress %6.0f MB/s\n", name, block,
+                packed_total / bytes, bytes / compress / 1e6, bytes / decompress / 1e6);
+}
+
+}
+
+int main()
+{
+    const std::vector<uint8_t> inputs[] = { telemetry(), text(), noise() };
+    const char* const names[] = { "telemetry", "text", "noise" };
+
+    for (size_t block : { size_t(256), size_t(1024), size_t(16384) })
+    {
+        for (int i = 0; i < 3; ++i)
+            run(names[i], inputs[i], block);
+    }
+
+    return 0;
+}
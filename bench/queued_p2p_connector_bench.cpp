@@ -0,0 +1,138 @@
+// Delay of urgent frames behind saturating bulk traffic, counted in link
+// bytes between queueing and delivery: a single FIFO, two priority levels,
+// and two levels with 64 byte fragments
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/packet_types.h>
+#include <datatransfer/queued_p2p_connector.hpp>
+#include <datatransfer/std_function_callback_handler.hpp>
+
+namespace {
+
+struct bulk
+{
+    uint8_t bytes[1000];
+
+    template <typename P>
+    void method(P& p) { p % bytes; }
+};
+
+struct command
+{
+    uint64_t stamp;
+
+    template <typename P>
+    void method(P& p) { p % stamp; }
+};
+
+// 1: bulk at the lowest level, 2: command at the highest
+template <int levels, size_t fragment_size>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 2;
+    static constexpr int MAX_MESSAGE_SIZE = 1000;
+    static constexpr int PRIORITY_LEVELS = levels;
+    static constexpr size_t FRAGMENT_SIZE = fragment_size;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    using header_type = datatransfer::length_packet_header;
+
+    template <int N>
+    struct data
+    {
+        using type = typename std::conditional<N == 1, bulk, command>::type;
+        static const int length = 1;
+        static const int priority = N == 2 ? levels - 1 : 0;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::crc16_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+// A link with a byte clock: every write advances it and the receiver sees
+// the bytes straight away
+struct link
+{
+    using char_type = char;
+
+    uint64_t clock = 0;
+    std::function<void(const char*, size_t)> on_write;
+
+    bool good() const { return true; }
+    int get() { return -1; }
+
+    link& write(const char_type* data, size_t n)
+    {
+        clock += n;
+        on_write(data, n);
+        return *this;
+    }
+
+    link& flush() { return *this; }
+};
+
+template <int levels, size_t fragment_size>
+void run(const char* name)
+{
+    using P = protocol<levels, fragment_size>;
+    using handler = datatransfer::std_function_callback_handler<P>;
+
+    link wire;
+    link unused;
+    datatransfer::queued_p2p_connector<std::mutex, link, P, handler, 16> tx(wire);
+    datatransfer::p2p_connector<std::mutex, link, P, handler> rx(unused);
+
+    std::vector<uint64_t> delays;
+    rx.template registerMessageHandler<2>([&](const command& c) { delays.push_back(wire.clock - c.stamp); });
+
+    // A command every 3001 link bytes, out of step with the bulk frames
+    const uint64_t period = 3001;
+    uint64_t next = period;
+    wire.on_write = [&](const char* data, size_t n)
+    {
+        rx.feed(reinterpret_cast<const uint8_t*>(data), n);
+        if (wire.clock >= next)
+        {
+            command c = { wire.clock };
+            tx.template send<2>(c);
+            next += period;
+        }
+    };
+
+    bulk b = {};
+    while (delays.size() < 1000)
+    {
+        while (tx.pending() < 8)
+            tx.template send<1>(b);
+        tx.flushPending();
+    }
+
+    std::sort(delays.begin(), delays.end());
+
+    // 115200 baud 8N1 moves 11520 bytes/s
+    std::cout << name << ": urgent frame delay p50 " << delays[delays.size() / 2] << " B, max " << delays.back()
+              << " B (" << delays.back() / 11.52 << " ms at 115200 baud)\n";
+}
+
+}
+
+int main()
+{
+    run<1, 0>("single FIFO         ");
+    run<2, 0>("2 levels            ");
+    run<2, 64>("2 levels, 64 B frags");
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Per-signal dispatch cost of rcu_callback_handler with one and four
+// subscribers, quiet and while another thread keeps replacing the list,
+// against std_function_callback_handler and boost::signals2 when available
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <datatransfer/rcu_callback_handler.hpp>
+#include <datatransfer/std_function_callback_handler.hpp>
+#include "bench_support.hpp"
+#ifdef DATATRANSFER_HAVE_BOOST
+#include <boost/signals2.hpp>
+#endif
+
+namespace {
+
+struct sample
+{
+    uint32_t value;
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+
+    template <int N>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+};
+
+const int signals = 10000000;
+
+volatile uint64_t sink;
+
+// Nanoseconds per call of emit(s)
+template <typename function>
+double nanosecondsPerSignal(function emit)
+{
+    return bestOf(5, [&]
+    {
+        for (int i = 0; i < signals; ++i)
+        {
+            sample s = { uint32_t(i) };
+            emit(s);
+        }
+    }) * 1e9 / signals;
+}
+
+}
+
+int main()
+{
+    uint64_t total = 0;
+    auto add = [&total](const sample& s) { total += s.value; };
+
+    datatransfer::std_function_callback_handler<protocol> single;
+    single.registerHandler<1>(add);
+    std::cout << "std_function_callback_handler:      "
+              << nanosecondsPerSignal([&](const sample& s) { single.signal<1>(s); }) << " ns\n";
+
+    for (int subscribers : { 1, 4 })
+    {
+        datatransfer::rcu_callback_handler<protocol> rcu;
+        for (int k = 0; k < subscribers; ++k)
+            rcu.registerHandler<1>(add);
+
+        std::cout << subscribers << " subscriber(s): rcu_callback_handler "
+                  << nanosecondsPerSignal([&](const sample& s) { rcu.signal<1>(s); }) << " ns";
+
+#ifdef DATATRANSFER_HAVE_BOOST
+        boost::signals2::signal<void(const sample&)> boost_signal;
+        for (int k = 0; k < subscribers; ++k)
+            boost_signal.connect(add);
+
+        std::cout << ", boost::signals2 " << nanosecondsPerSignal([&](const sample& s) { boost_signal(s); }) << " ns";
+#endif
+        std::cout << "\n";
+
+        // Readers never wait for the writer, only the writer for readers
+        std::atomic<bool> done(false);
+        std::thread writer([&]
+        {
+            while (!done.load(std::memory_order_relaxed))
+                rcu.deregisterHandler<1>(rcu.registerHandler<1>(add));
+        });
+
+        std::cout << subscribers << " subscriber(s), concurrent updates: rcu_callback_handler "
+                  << nanosecondsPerSignal([&](const sample& s) { rcu.signal<1>(s); }) << " ns\n";
+
+        done.store(true, std::memory_order_relaxed);
+        writer.join();
+    }
+
+    sink = total;
+    return 0;
+}
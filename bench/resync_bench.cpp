@@ -0,0 +1,202 @@
+// Frames recovered intact from a corrupted byte stream by the parser,
+// against a model of the previous one that resumed hunting for a sync after
+// the bytes of a rejected frame instead of right after its false SYNC_1.
+// Payloads are full of sync bytes, so false syncs are common.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+
+namespace {
+
+struct sample
+{
+    uint32_t sequence;
+    uint8_t fill[12];
+
+    template <typename P>
+    void method(P& p) { p % sequence; p % fill; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 32;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::crc16_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, datatransfer::callback_handler<protocol>>;
+
+const uint32_t frames = 40000;
+
+std::vector<bool> seen;
+size_t intact;
+size_t accepted;
+
+void fillPattern(sample& s)
+{
+    for (size_t i = 0; i < sizeof(s.fill); ++i)
+        s.fill[i] = (i + s.sequence) % 3 == 0 ? 0xAA : 0x55;
+}
+
+// Counts each frame that arrives unchanged once
+void onSample(const sample& s)
+{
+    ++accepted;
+
+    sample expected;
+    expected.sequence = s.sequence;
+    fillPattern(expected);
+    if (s.sequence < frames && !seen[s.sequence] &&
+        std::equal(s.fill, s.fill + sizeof(s.fill), expected.fill))
+    {
+        seen[s.sequence] = true;
+        ++intact;
+    }
+}
+
+void reset()
+{
+    seen.assign(frames, false);
+    intact = 0;
+    accepted = 0;
+}
+
+std::vector<uint8_t> encode(size_t& frame_size)
+{
+    std::stringstream out;
+    connector tx(out);
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        sample s;
+        s.sequence = i;
+        fillPattern(s);
+        tx.send<1>(s);
+    }
+
+    const std::string wire = out.str();
+    frame_size = wire.size() / frames;
+    return std::vector<uint8_t>(wire.begin(), wire.end());
+}
+
+size_t parseCurrent(const std::vector<uint8_t>& wire)
+{
+    reset();
+
+    std::stringstream unused;
+    connector rx(unused);
+    rx.registerMessageHandler<1>(&onSample);
+    for (size_t offset = 0; offset < wire.size(); offset += 4096)
+        rx.feed(wire.data() + offset, std::min<size_t>(4096, wire.size() - offset));
+
+    return intact;
+}
+
+// The previous parser: a SYNC_2 mismatch consumed the byte after SYNC_1 and
+// a rejected frame all of its bytes. Whether the bytes at a sync form a
+// valid frame is decided by the current parser on those bytes alone.
+size_t parsePrevious(const std::vector<uint8_t>& wire, size_t frame_size)
+{
+    reset();
+
+    std::stringstream unused;
+    connector judge(unused);
+    judge.registerMessageHandler<1>(&onSample);
+
+    size_t i = 0;
+    while (i + 1 < wire.size())
+    {
+        if (wire[i] != 0x55)
+            i += 1;
+        else if (wire[i + 1] != 0xAA)
+            i += 2;
+        else if (i + 2 < wire.size() && !protocol::valid(wire[i + 2]))
+            i += 3;
+        else
+        {
+            if (i + frame_size <= wire.size())
+                judge.feedDatagram(wire.data() + i, frame_size);
+
+            i += frame_size;
+        }
+    }
+
+    return intact;
+}
+
+std::vector<uint8_t> flipBits(const std::vector<uint8_t>& wire, double rate, std::mt19937& random)
+{
+    std::vector<uint8_t> out(wire);
+    std::bernoulli_distribution flip(rate);
+    for (auto& byte : out)
+    {
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            if (flip(random))
+                byte ^= uint8_t(1 << bit);
+        }
+    }
+
+    return out;
+}
+
+std::vector<uint8_t> dropBytes(const std::vector<uint8_t>& wire, double rate, std::mt19937& random)
+{
+    std::vector<uint8_t> out;
+    std::bernoulli_distribution drop(rate);
+    for (uint8_t byte : wire)
+    {
+        if (!drop(random))
+            out.push_back(byte);
+    }
+
+    return out;
+}
+
+void report(const char* damage, double rate, const std::vector<uint8_t>& damaged, size_t frame_size)
+{
+    const size_t previous = parsePrevious(damaged, frame_size);
+    const size_t current = parseCurrent(damaged);
+    std::printf("%-12s %-8g previous %6zu  current %6zu  (+%zu)\n", damage, rate, previous, current,
+                current > previous ? current - previous : 0);
+}
+
+}
+
+int main()
+{
+    size_t frame_size;
+    const std::vector<uint8_t> wire = encode(frame_size);
+    std::mt19937 random(1);
+
+    std::printf("%u frames of %zu bytes, intact frames recovered\n", frames, frame_size);
+    report("none", 0, wire, frame_size);
+    for (double rate : { 1e-4, 1e-3, 1e-2 })
+        report("bit errors", rate, flipBits(wire, rate, random), frame_size);
+    for (double rate : { 1e-3, 1e-2 })
+        report("byte drops", rate, dropBytes(wire, rate, random), frame_size);
+
+    return 0;
+}
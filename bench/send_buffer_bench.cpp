@@ -0,0 +1,112 @@
+// Small telemetry frames over an unbuffered descriptor, where every stream
+// call is a system call: single sends against batches of 100
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "bench_support.hpp"
+
+namespace {
+
+struct null_device_stream
+{
+    using char_type = char;
+
+    int fd = ::open("/dev/null", O_WRONLY);
+    size_t calls = 0;
+
+    ~null_device_stream() { ::close(fd); }
+
+    bool good() const { return fd >= 0; }
+    int get() { return -1; }
+
+    null_device_stream& write(const char_type* data, size_t n)
+    {
+        ++calls;
+        if (::write(fd, data, n) < 0)
+            fd = -1;
+        return *this;
+    }
+
+    // Stands in for the system call an unbuffered stream makes to flush
+    null_device_stream& flush()
+    {
+        ++calls;
+        ::fsync(-1);
+        return *this;
+    }
+};
+
+struct telemetry
+{
+    uint32_t id;
+    uint16_t value;
+    uint8_t flags;
+
+    template <typename P>
+    void method(P& p) { p % id; p % value; p % flags; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = telemetry;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, null_device_stream, protocol, datatransfer::callback_handler<protocol>>;
+
+}
+
+int main()
+{
+    const int sends = 200000;
+
+    null_device_stream out;
+    connector c(out);
+    telemetry t = { 1, 2, 3 };
+
+    const double single = bestOf(3, [&]
+    {
+        for (int i = 0; i < sends; ++i)
+            c.send<1>(t);
+    });
+    const double single_calls = double(out.calls) / (3.0 * sends);
+
+    out.calls = 0;
+    const double batched = bestOf(3, [&]
+    {
+        for (int i = 0; i < sends; i += 100)
+        {
+            auto batch = c.beginBatch();
+            for (int k = 0; k < 100; ++k)
+                batch.send<1>(t);
+        }
+    });
+    const double batched_calls = double(out.calls) / (3.0 * sends);
+
+    std::cout << "send():       " << sends / single / 1e6 << " M msg/s, " << single_calls << " stream calls/msg\n";
+    std::cout << "batch of 100: " << sends / batched / 1e6 << " M msg/s, " << batched_calls << " stream calls/msg\n";
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+// shm_stream against a Unix socketpair between two processes: ping-pong
+// round trip latency, then one way throughput of 40 byte frames
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/fd_stream.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/shm_stream.hpp>
+#include <datatransfer/std_function_callback_handler.hpp>
+
+using datatransfer::fd_stream;
+using datatransfer::shm_stream;
+
+namespace {
+
+struct message
+{
+    uint64_t sequence;
+    uint8_t pad[24];
+
+    template <typename P>
+    void method(P& p) { p % sequence; p % pad; }
+};
+
+// 1: ping and pong, 2: bulk frame, 3: bulk run finished
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 3;
+    static constexpr int MAX_MESSAGE_SIZE = 64;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    template <int N>
+    struct data
+    {
+        using type = message;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+template <typename stream>
+using connector = datatransfer::p2p_connector<std::mutex, stream, protocol, datatransfer::std_function_callback_handler<protocol>>;
+
+using clock = std::chrono::steady_clock;
+
+const int pings = 20000;
+const uint64_t frames = 2000000;
+
+template <typename stream>
+[[noreturn]] void responder(stream& s)
+{
+    connector<stream> c(s);
+    uint64_t received = 0;
+
+    c.template registerMessageHandler<1>([&c](const message& m)
+    {
+        message pong = m;
+        c.template send<1>(pong);
+    });
+    c.template registerMessageHandler<2>([&c, &received](const message&)
+    {
+        if (++received == frames)
+        {
+            message done = {};
+            done.sequence = received;
+            c.template send<3>(done);
+        }
+    });
+
+    c.read();
+    _exit(0);
+}
+
+// Ends the process once the bulk run is reported finished
+template <typename stream>
+[[noreturn]] void initiator(const char* name, stream& s, pid_t responder_pid)
+{
+    connector<stream> c(s);
+    std::vector<double> round_trips;
+    round_trips.reserve(pings);
+    clock::time_point sent;
+    clock::time_point bulk_start;
+    message m = {};
+
+    c.template registerMessageHandler<1>([&](const message& pong)
+    {
+        round_trips.push_back(std::chrono::duration<double, std::micro>(clock::now() - sent).count());
+        if (int(pong.sequence) + 1 < pings)
+        {
+            m.sequence = pong.sequence + 1;
+            sent = clock::now();
+            c.template send<1>(m);
+            return;
+        }
+
+        bulk_start = clock::now();
+        auto batch = c.beginBatch();
+        for (uint64_t i = 0; i < frames; ++i)
+        {
+            m.sequence = i;
+            batch.template send<2>(m);
+        }
+    });
+    c.template registerMessageHandler<3>([&](const message&)
+    {
+        const double seconds = std::chrono::duration<double>(clock::now() - bulk_start).count();
+        std::sort(round_trips.begin(), round_trips.end());
+        std::printf("%s: round trip p50 %.1f us p99 %.1f us, one way %.2f M frames/s (%.0f MB/s)\n", name,
+                    round_trips[round_trips.size() / 2], round_trips[round_trips.size() * 99 / 100],
+                    frames / seconds / 1e6, frames * 40.0 / seconds / 1e6);
+        std::fflush(stdout);
+
+        kill(responder_pid, SIGKILL);
+        waitpid(responder_pid, nullptr, 0);
+        _exit(0);
+    });
+
+    sent = clock::now();
+    c.template send<1>(m);
+    c.read();
+    _exit(1);
+}
+
+[[noreturn]] void runSocket()
+{
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+        _exit(1);
+
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(pair[0]);
+        fd_stream s(pair[1]);
+        responder(s);
+    }
+
+    close(pair[1]);
+    fd_stream s(pair[0]);
+    initiator("unix socket", s, pid);
+}
+
+std::string segmentName(pid_t pid)
+{
+    return "/datatransfer_bench_" + std::to_string(pid);
+}
+
+[[noreturn]] void runSharedMemory()
+{
+    const std::string name = segmentName(getpid());
+    shm_stream<> created(name.c_str(), shm_stream<>::CREATE);
+
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        shm_stream<> opened(name.c_str(), shm_stream<>::OPEN);
+        responder(opened);
+    }
+
+    initiator("shm_stream ", created, pid);
+}
+
+}
+
+int main()
+{
+    // Each run ends the process it runs in without unwinding, so the
+    // segment left behind by the shared memory run is removed here
+    void (*runs[])() = { &runSocket, &runSharedMemory };
+    for (auto run : runs)
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+            run();
+
+        waitpid(pid, nullptr, 0);
+        if (run == &runSharedMemory)
+            shm_unlink(segmentName(pid).c_str());
+    }
+
+    return 0;
+}
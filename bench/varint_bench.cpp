@@ -0,0 +1,115 @@
+// Wire size and cost of small integer telemetry, fixed width against varint
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/packet_types.h>
+#include <datatransfer/varint_serialization.hpp>
+
+namespace {
+
+// Counters, ids and small deltas declared wider than their values
+struct status
+{
+    uint32_t counter;
+    uint32_t id;
+    int32_t dx, dy, dz;
+    uint64_t uptime_ms;
+    uint16_t flags;
+
+    template <typename P>
+    void method(P& p) { p % counter; p % id; p % dx; p % dy; p % dz; p % uptime_ms; p % flags; }
+};
+
+template <typename serialization_type>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 64;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    using header_type = datatransfer::length_packet_header;
+
+    template <int N>
+    struct data
+    {
+        using type = status;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = typename serialization_type::template write_policy<io>;
+        using read_policy = typename serialization_type::template read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = typename serialization_type::checksum_policy;
+        using size_policy = typename serialization_type::size_policy;
+    };
+};
+
+volatile uint32_t sink;
+
+void onStatus(const status& s)
+{
+    sink = sink + s.counter;
+}
+
+template <typename serialization_type>
+void run(const char* name)
+{
+    using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<serialization_type>,
+                                                  datatransfer::callback_handler<protocol<serialization_type>>>;
+    const int messages = 20000;
+
+    std::mt19937 random(1);
+    std::vector<status> samples(messages);
+    for (int i = 0; i < messages; ++i)
+    {
+        samples[i] = status{ uint32_t(i), uint32_t(random() % 200), int32_t(random() % 41) - 20,
+                             int32_t(random() % 41) - 20, int32_t(random() % 41) - 20,
+                             3600000ull + i * 10, uint16_t(random() % 8) };
+    }
+
+    double send_best = 1e9;
+    double receive_best = 1e9;
+    size_t bytes = 0;
+    for (int repeat = 0; repeat < 7; ++repeat)
+    {
+        std::stringstream out;
+        connector c(out);
+
+        auto start = std::chrono::steady_clock::now();
+        for (status& s : samples)
+            c.template send<1>(s);
+        send_best = std::min(send_best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+
+        const std::string wire = out.str();
+        bytes = wire.size();
+        c.template registerMessageHandler<1>(&onStatus);
+
+        start = std::chrono::steady_clock::now();
+        c.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+        receive_best = std::min(receive_best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::cout << name << ": " << double(bytes) / messages << " B/frame, send " << send_best / messages
+              << " ns, receive " << receive_best / messages << " ns\n";
+}
+
+}
+
+int main()
+{
+    run<datatransfer::binary_serialization>("fixed ");
+    run<datatransfer::varint_serialization>("varint");
+
+    return 0;
+}
@@ -0,0 +1,377 @@
+#ifndef DATATRANSFER_ASYNC_CALLBACK_HANDLER_HPP
+#define DATATRANSFER_ASYNC_CALLBACK_HANDLER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "message_table.hpp"
+#include "mpmc_queue.hpp"
+
+namespace datatransfer {
+
+// Callback handler that runs handlers on a thread pool instead of the
+// parsing thread. signal<N>() copies the message into a preallocated
+// single-producer/single-consumer queue for type N and schedules the type
+// on a worker. A type is scheduled on at most one worker at a time, so its
+// handler sees messages in arrival order. Idle workers steal scheduled
+// types from busy ones.
+//
+// Register handlers before start(). signal() must be called from a single
+// thread, which is how p2p_connector calls it; before start() handlers run
+// inline. When a queue is full the message is dropped, or with
+// block_when_full the parser waits.
+template <typename serialization_policy,
+          size_t queue_size = 256,
+          bool block_when_full = false>
+class async_callback_handler
+{
+    static_assert(queue_size >= 2 && (queue_size & (queue_size - 1)) == 0, "Queue size must be a power of two");
+
+    enum
+    {
+        // Messages handled per scheduling of a type before yielding the worker
+        BATCH_SIZE = 64,
+        SPIN_COUNT = 256,
+        MAX_WORKERS = 32
+    };
+
+    static constexpr size_t task_queue_size(size_t n, size_t size = 2)
+    {
+        return size >= n ? size : task_queue_size(n, size * 2);
+    }
+
+public:
+    template <int N>
+    using function_type = std::function<void(const typename serialization_policy::template data<N>::type&)>;
+
+    async_callback_handler()
+        : _worker_count(0)
+        , _running(false)
+        , _sleeping(0)
+        , _dropped(0)
+    {}
+
+    ~async_callback_handler()
+    {
+        stop();
+    }
+
+    // Starts up to MAX_WORKERS threads; cpus, when given, pins worker i to
+    // cpus[i % size]
+    void start(size_t threads, const std::vector<int>& cpus = std::vector<int>())
+    {
+        if (threads == 0 || _running.exchange(true))
+            return;
+
+        _worker_count = threads < size_t(MAX_WORKERS) ? threads : size_t(MAX_WORKERS);
+
+        for (size_t i = 0; i < _worker_count; ++i)
+        {
+            _workers[i].thread = std::thread([this, i] { workerLoop(i); });
+
+#ifdef __linux__
+            if (!cpus.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpus[i % cpus.size()], &set);
+                pthread_setaffinity_np(_workers[i].thread.native_handle(), sizeof(set), &set);
+            }
+#else
+            (void)cpus;
+#endif
+        }
+    }
+
+    // Joins the workers and runs whatever is still queued on the calling
+    // thread. start() and stop() must not race with signal().
+    void stop()
+    {
+        if (!_running.exchange(false))
+            return;
+
+        _wakeup.notify_all();
+        for (size_t i = 0; i < _worker_count; ++i)
+            _workers[i].thread.join();
+
+        _worker_count = 0;
+
+        for (int id = 1; id <= serialization_policy::NUMBER_OF_MESSAGES; ++id)
+        {
+            while (task_table::lookup(id).run(*this)) {}
+        }
+    }
+
+    size_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    template <int N>
+    void signal(const typename serialization_policy::template data<N>::type& t)
+    {
+        channel<N>& c = RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_channels);
+
+        if (c.function == nullptr)
+            return;
+
+        while (!c.queue.push(t))
+        {
+            if (!block_when_full || !_running.load(std::memory_order_relaxed))
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            std::this_thread::yield();
+        }
+
+        schedule<N>(c);
+    }
+
+    template <int N>
+    void registerHandler(function_type<N> func)
+    {
+        RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_channels).function = func;
+    }
+
+    template <int N>
+    void deregisterHandler()
+    {
+        RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_channels).function = nullptr;
+    }
+
+protected:
+    template <typename T>
+    class spsc_queue
+    {
+    public:
+        spsc_queue()
+            : _head(0)
+            , _tail(0)
+        {}
+
+        bool push(const T& t)
+        {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail - _head.load(std::memory_order_acquire) == queue_size)
+                return false;
+
+            _slots[tail & (queue_size - 1)] = t;
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        const T* front() const
+        {
+            const size_t head = _head.load(std::memory_order_relaxed);
+            if (head == _tail.load(std::memory_order_acquire))
+                return nullptr;
+
+            return &_slots[head & (queue_size - 1)];
+        }
+
+        void pop()
+        {
+            _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        bool empty() const { return front() == nullptr; }
+
+    private:
+        T _slots[queue_size];
+        alignas(64) std::atomic<size_t> _head;
+        alignas(64) std::atomic<size_t> _tail;
+    };
+
+    template <int N>
+    struct channel
+    {
+        channel()
+            : function(nullptr)
+            , scheduled(false)
+        {}
+
+        function_type<N> function;
+        spsc_queue<typename serialization_policy::template data<N>::type> queue;
+        std::atomic<bool> scheduled;
+    };
+
+    template <int N, int count>
+    struct ChannelHelper
+    {
+        channel<N> first;
+        ChannelHelper<N+1, count-1> second;
+    };
+
+    template <int N>
+    struct ChannelHelper<N, 0> { };
+
+    template <int id, int N, int count>
+    struct RetrieveHelper
+    {
+        static constexpr channel<id>& retrieve(ChannelHelper<N, count>& helper)
+        {
+            return RetrieveHelper<id,N+1,count-1>::retrieve(helper.second);
+        }
+    };
+
+    template <int id, int count>
+    struct RetrieveHelper<id, id, count>
+    {
+        static constexpr channel<id>& retrieve(ChannelHelper<id, count>& helper)
+        {
+            return helper.first;
+        }
+    };
+
+private:
+    struct task_operations
+    {
+        // Returns true if messages are left
+        bool (*run)(async_callback_handler&);
+        void (*reschedule)(async_callback_handler&);
+    };
+
+    template <int N>
+    struct TaskOperations
+    {
+        static bool run(async_callback_handler& handler)
+        {
+            channel<N>& c = RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(handler._channels);
+
+            for (int i = 0; i < BATCH_SIZE; ++i)
+            {
+                auto message = c.queue.front();
+                if (message == nullptr)
+                    break;
+
+                if (c.function != nullptr)
+                    c.function(*message);
+                c.queue.pop();
+            }
+
+            // Releases the handler state to whichever worker takes the type
+            // next. The fence orders the store before looking at the queue
+            // again, pairing with the fence in schedule().
+            c.scheduled.store(false, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return !c.queue.empty();
+        }
+
+        static void reschedule(async_callback_handler& handler)
+        {
+            handler.template schedule<N>(RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(handler._channels));
+        }
+
+        static constexpr task_operations make()
+        {
+            return task_operations{ &run, &reschedule };
+        }
+    };
+
+    using message_ids = typename make_message_sequence<1, serialization_policy::NUMBER_OF_MESSAGES>::type;
+    using task_table = message_table<task_operations, TaskOperations, message_ids>;
+
+    struct worker
+    {
+        // Each type is queued at most once, so pushes never fail
+        mpmc_queue<int, task_queue_size(serialization_policy::NUMBER_OF_MESSAGES)> tasks;
+        std::thread thread;
+    };
+
+    template <int N>
+    void schedule(channel<N>& c)
+    {
+        // Orders the push before reading the flag. Otherwise a worker could
+        // clear it and find the queue empty while we still see it set, and
+        // the message would wait for the next one of its type.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (c.scheduled.load(std::memory_order_relaxed) || c.scheduled.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        if (_worker_count == 0)
+        {
+            // Not started, run on the calling thread
+            while (TaskOperations<N>::run(*this)) {}
+            return;
+        }
+
+        _workers[N % _worker_count].tasks.try_push([](int& task) { task = N; });
+
+        if (_sleeping.load(std::memory_order_seq_cst) > 0)
+            _wakeup.notify_one();
+    }
+
+    bool takeTask(size_t self, int& task)
+    {
+        auto take = [&task](int& t) { task = t; };
+
+        if (_workers[self].tasks.try_pop(take))
+            return true;
+
+        for (size_t i = 1; i < _worker_count; ++i)
+        {
+            if (_workers[(self + i) % _worker_count].tasks.try_pop(take))
+                return true;
+        }
+
+        return false;
+    }
+
+    void workerLoop(size_t self)
+    {
+        int idle = 0;
+        int task;
+
+        for (;;)
+        {
+            if (takeTask(self, task))
+            {
+                const task_operations& operations = task_table::lookup(task);
+
+                // Messages that arrived while the flag was still set
+                if (operations.run(*this))
+                    operations.reschedule(*this);
+
+                idle = 0;
+            }
+            else if (!_running.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            else if (++idle < SPIN_COUNT)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                // The timeout covers a wake-up racing with going to sleep
+                std::unique_lock<std::mutex> lock(_sleep_mutex);
+                _sleeping.fetch_add(1, std::memory_order_seq_cst);
+                _wakeup.wait_for(lock, std::chrono::milliseconds(1));
+                _sleeping.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ChannelHelper<1, serialization_policy::NUMBER_OF_MESSAGES> _channels;
+    worker _workers[MAX_WORKERS];
+    size_t _worker_count;
+    std::atomic<bool> _running;
+    std::atomic<int> _sleeping;
+    std::atomic<size_t> _dropped;
+    std::mutex _sleep_mutex;
+    std::condition_variable _wakeup;
+};
+
+}
+
+#endif // DATATRANSFER_ASYNC_CALLBACK_HANDLER_HPP
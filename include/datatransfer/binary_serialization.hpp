@@ -1,9 +1,73 @@
 #ifndef DATATRANSFER_BINARY_SERIALIZATION_HPP
 #define DATATRANSFER_BINARY_SERIALIZATION_HPP
 
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+#include "crc.hpp"
+#include "varint.hpp"
+
 namespace datatransfer
 {
 
+// Types whose binary encoding is byte-for-byte identical to their in-memory
+// representation. Specialise for packed message structs whose method()
+// visits every field in declaration order.
+template <typename T>
+struct is_bitwise_serializable : std::is_arithmetic<T> {};
+
+template <typename T, size_t N>
+struct is_bitwise_serializable<T[N]> : is_bitwise_serializable<T> {};
+
+// Walks T::method() at compile time only: instantiating visit<T>() fails
+// for types whose encoded size depends on their contents, i.e. sequences
+// such as bounded_vector and varint fields
+class fixed_size_check
+{
+public:
+    template <typename T>
+    static void visit(T& t)
+    {
+        fixed_size_check check;
+        check % t;
+    }
+
+    template <typename T>
+    fixed_size_check& operator% (T& x)
+    {
+        operate(x);
+        return *this;
+    }
+
+    template <typename T>
+    fixed_size_check& operator% (varint_field<T>)
+    {
+        static_assert(sizeof(T) == 0, "Varint fields need a header type with a length field");
+        return *this;
+    }
+
+    template <typename T>
+    fixed_size_check& sequence(T*, size_t)
+    {
+        static_assert(sizeof(T) == 0, "Variable length sequences need a header type with a length field");
+        return *this;
+    }
+
+private:
+    template <typename T>
+    void operate(T& x) { operate(x, is_bitwise_serializable<T>()); }
+
+    template <typename T, size_t N>
+    void operate(T (&x)[N]) { operate(x[0]); }
+
+    template <typename T>
+    void operate(T&, std::true_type) {}
+
+    template <typename T>
+    void operate(T& x, std::false_type) { x.method(*this); }
+};
+
 struct binary_serialization
 {
     class size_policy_base
@@ -12,6 +76,9 @@ struct binary_serialization
         using data_type = size_t;
         using return_type = void;
 
+        // Encoded sizes only vary with sequences and varint fields
+        static constexpr bool FIXED_WIDTH = true;
+
     protected:
         size_policy_base()
             : _size(0)
@@ -20,10 +87,37 @@ struct binary_serialization
         template <typename T>
         return_type action(T&) { _size += sizeof(T); }
 
+        template <typename T>
+        return_type action(T*, size_t count) { _size += sizeof(T) * count; }
+
+        template <typename T>
+        return_type varint_action(T& t) { _size += leb128::encoded_size(leb128::encode_value(t)); }
+
     public:
         data_type size() const { return _size; }
 
+        // Upper bound on the encoded size of T, fields are written without padding
+        template <typename T>
+        static constexpr data_type wire_size_bound() { return sizeof(T); }
+
+        // Exact encoded size of T, measured once on first use
+        template <typename T>
+        static data_type wire_size()
+        {
+            static const data_type size = measure<T>();
+            return size;
+        }
+
     private:
+        template <typename T>
+        static data_type measure()
+        {
+            alignas(T) uint8_t storage[sizeof(T)] = {};
+            primitives<size_policy_base> s;
+            s.operate(*reinterpret_cast<T*>(storage));
+            return s.size();
+        }
+
         data_type _size;
     };
 
@@ -46,6 +140,20 @@ struct binary_serialization
             _os.write(reinterpret_cast<const typename output_stream::char_type*>(&t), sizeof(T));
         }
 
+        template <typename T>
+        return_type action(const T* t, size_t count)
+        {
+            _os.write(reinterpret_cast<const typename output_stream::char_type*>(t), sizeof(T) * count);
+        }
+
+        template <typename T>
+        return_type varint_action(const T& t)
+        {
+            uint8_t buf[leb128::MAX_SIZE];
+            const size_t n = leb128::encode(leb128::encode_value(t), buf);
+            _os.write(reinterpret_cast<const typename output_stream::char_type*>(buf), n);
+        }
+
     private:
         output_stream& _os;
     };
@@ -62,16 +170,19 @@ struct binary_serialization
             stream_type()
                 : n(0)
                 , index(0)
+                , underflow(false)
             {}
 
             void clear()
             {
                 n = index = 0;
+                underflow = false;
             }
 
             void reset()
             {
                 index = 0;
+                underflow = false;
             }
 
             void receive(char_type c)
@@ -80,12 +191,53 @@ struct binary_serialization
                     data[n++] = c;
             }
 
+            // Takes bytes of any one byte type, connectors pass uint8_t
+            // whatever char_type the policy reads into
+            template <typename byte_type>
+            void receive(const byte_type* buf, int bytes)
+            {
+                static_assert(sizeof(byte_type) == 1, "receive() takes raw bytes");
+
+                if (bytes > N - n)
+                    bytes = N - n;
+
+                memcpy(&data[n], buf, bytes);
+                n += bytes;
+            }
+
             int size() const { return n; }
 
+            static constexpr int capacity() { return N; }
+
+            int remaining() const { return n - index; }
+
+            // True if a read asked for more bytes than were left or the
+            // data was malformed
+            bool failed() const { return underflow; }
+            void fail() { underflow = true; }
+
+            const char_type* peek() const { return &data[index]; }
+
+            void consume(int bytes)
+            {
+                if (bytes > n - index)
+                {
+                    underflow = true;
+                    bytes = n - index;
+                }
+
+                index += bytes;
+            }
+
             size_t read(void* buf, int bytes)
             {
                 const auto bytes_remaining = n - index;
                 int to_read = 0;
+                if (bytes > bytes_remaining)
+                {
+                    underflow = true;
+                }
+
                 if (bytes_remaining == 0)
                 {
                     return -1;
@@ -106,6 +258,7 @@ struct binary_serialization
 
         private:
             int index;
+            bool underflow;
         };
 
         using return_type = bool;
@@ -124,6 +277,30 @@ struct binary_serialization
             return _is.read(buf, n) == n;
         }
 
+        template <typename T>
+        return_type action(T* t, size_t count)
+        {
+            const int n = sizeof(T) * count;
+            auto buf = reinterpret_cast<char_type*>(t);
+            return n == 0 || _is.read(buf, n) == size_t(n);
+        }
+
+        template <typename T>
+        return_type varint_action(T& t)
+        {
+            uint64_t v;
+            const size_t n = leb128::decode(reinterpret_cast<const uint8_t*>(_is.peek()), _is.remaining(), v);
+            if (n == 0)
+            {
+                _is.fail();
+                return false;
+            }
+
+            _is.consume(n);
+            t = leb128::decode_value<T>(v);
+            return true;
+        }
+
     private:
         stream_type& _is;
     };
@@ -145,14 +322,78 @@ struct binary_serialization
         return_type action(T& t)
         {
             // Assume little endian encoding
-            auto* buf = reinterpret_cast<const data_type*>(&t);
-            for (size_t i = 0; i < sizeof(T); ++i)
+            update(&t, sizeof(T));
+        }
+
+        template <typename T>
+        return_type action(T* t, size_t count)
+        {
+            update(t, sizeof(T) * count);
+        }
+
+        template <typename T>
+        return_type varint_action(T& t)
+        {
+            uint8_t buf[leb128::MAX_SIZE];
+            update(buf, leb128::encode(leb128::encode_value(t), buf));
+        }
+
+    public:
+        data_type checksum() const { return _checksum; }
+
+        void update(const void* data, size_t bytes)
+        {
+            auto* buf = static_cast<const data_type*>(data);
+            for (size_t i = 0; i < bytes; ++i)
                 _checksum ^= buf[i];
         }
 
+    private:
+        data_type& _checksum;
+    };
+
+    template <typename crc>
+    class crc_policy_base
+    {
+    public:
+        using data_type = typename crc::value_type;
+        using return_type = void;
+
+    protected:
+        crc_policy_base(data_type& checksum)
+            : _checksum(checksum)
+        {
+            _checksum = crc::INITIAL;
+        }
+
+        template <typename T>
+        return_type action(T& t)
+        {
+            // Assume little endian encoding
+            update(&t, sizeof(T));
+        }
+
+        template <typename T>
+        return_type action(T* t, size_t count)
+        {
+            update(t, sizeof(T) * count);
+        }
+
+        template <typename T>
+        return_type varint_action(T& t)
+        {
+            uint8_t buf[leb128::MAX_SIZE];
+            update(buf, leb128::encode(leb128::encode_value(t), buf));
+        }
+
     public:
         data_type checksum() const { return _checksum; }
 
+        void update(const void* data, size_t bytes)
+        {
+            _checksum = crc::update(_checksum, data, bytes);
+        }
+
     private:
         data_type& _checksum;
     };
@@ -161,6 +402,9 @@ struct binary_serialization
     class primitives : public policy
     {
     public:
+        template <typename T>
+        using bitwise = is_bitwise_serializable<T>;
+
         primitives(Args ...args)
             : policy(args...)
         {}
@@ -178,8 +422,24 @@ struct binary_serialization
         {
             static_assert(N > 0, "Array size must be greater than 0");
 
-            for (int i = 0; i < N; ++i)
-                operate(x[i]);
+            operate(x, bitwise<T>());
+
+            return *this;
+        }
+
+        template <typename T>
+        primitives<policy, Args...>& operator% (varint_field<T> x)
+        {
+            policy::varint_action(x.value);
+
+            return *this;
+        }
+
+        // Visits the first count elements of x, used for variable length sequences
+        template <typename T>
+        primitives<policy, Args...>& sequence(T* x, size_t count)
+        {
+            sequence(x, count, bitwise<T>());
 
             return *this;
         }
@@ -187,7 +447,7 @@ struct binary_serialization
         template <typename T>
         void operate(T& t)
         {
-            t.method(*this);
+            operate(t, bitwise<T>());
         }
 
         void operate(float& x)			{ policy::action(x); }
@@ -201,6 +461,31 @@ struct binary_serialization
         void operate(uint32_t& x)       { policy::action(x); }
         void operate(int64_t& x)        { policy::action(x); }
         void operate(uint64_t& x)		{ policy::action(x); }
+
+    private:
+        // Encoding matches the memory layout, handle the whole object at once
+        template <typename T>
+        void operate(T& t, std::true_type) { policy::action(t); }
+
+        template <typename T>
+        void operate(T& t, std::false_type) { t.method(*this); }
+
+        template <typename T, int N>
+        void operate(T (&x)[N], std::false_type)
+        {
+            for (int i = 0; i < N; ++i)
+                operate(x[i]);
+        }
+
+        template <typename T>
+        void sequence(T* x, size_t count, std::true_type) { policy::action(x, count); }
+
+        template <typename T>
+        void sequence(T* x, size_t count, std::false_type)
+        {
+            for (size_t i = 0; i < count; ++i)
+                operate(x[i]);
+        }
     };
 
     template <typename output_stream>
@@ -211,6 +496,15 @@ struct binary_serialization
 
     using checksum_policy = primitives<checksum_policy_base, checksum_policy_base::data_type&>;
     using size_policy = primitives<size_policy_base>;
+
+    using crc16_policy = primitives<crc_policy_base<crc16_ccitt>, crc16_ccitt::value_type&>;
+    using crc32c_policy = primitives<crc_policy_base<crc32c>, crc32c::value_type&>;
+
+    template <typename T>
+    static size_t wire_size() { return size_policy::wire_size<T>(); }
+
+    template <typename T>
+    static constexpr size_t wire_size_bound() { return size_policy::wire_size_bound<T>(); }
 };
 
 }
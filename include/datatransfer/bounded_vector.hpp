@@ -0,0 +1,138 @@
+#ifndef DATATRANSFER_BOUNDED_VECTOR_HPP
+#define DATATRANSFER_BOUNDED_VECTOR_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+namespace datatransfer {
+
+// Fixed capacity sequence serialized as a 16 bit element count followed by
+// the live elements only. Its encoded size depends on the contents, so
+// messages containing one need a header type with a length field
+// (length_packet_header).
+template <typename T, size_t N>
+class bounded_vector
+{
+    static_assert(N > 0 && N <= UINT16_MAX, "Capacity must be between 1 and 65535");
+
+public:
+    using value_type = T;
+    using size_type = uint16_t;
+
+    bounded_vector()
+        : _size(0)
+    {}
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    T* data() { return _data; }
+    const T* data() const { return _data; }
+
+    T* begin() { return _data; }
+    T* end() { return _data + _size; }
+    const T* begin() const { return _data; }
+    const T* end() const { return _data + _size; }
+
+    T& operator[](size_t i) { return _data[i]; }
+    const T& operator[](size_t i) const { return _data[i]; }
+
+    void clear() { _size = 0; }
+
+    bool push_back(const T& t)
+    {
+        if (_size == N)
+            return false;
+
+        _data[_size++] = t;
+        return true;
+    }
+
+    // Clamped to the capacity
+    void resize(size_t n)
+    {
+        _size = size_type(n < N ? n : N);
+    }
+
+    template <typename policy>
+    void method(policy& p)
+    {
+        p % _size;
+
+        // A corrupt count fails to consume the payload and is rejected
+        if (_size > N)
+            _size = N;
+
+        p.sequence(_data, _size);
+    }
+
+private:
+    size_type _size;
+    T _data[N];
+};
+
+// Up to N bytes of opaque data
+template <size_t N>
+using bounded_bytes = bounded_vector<uint8_t, N>;
+
+// Up to N characters, always null terminated in memory but not on the wire
+template <size_t N>
+class bounded_string
+{
+    static_assert(N > 0 && N <= UINT16_MAX, "Capacity must be between 1 and 65535");
+
+public:
+    using size_type = uint16_t;
+
+    bounded_string()
+        : _size(0)
+    {
+        _data[0] = '\0';
+    }
+
+    bounded_string(const char* s)
+    {
+        assign(s);
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    const char* c_str() const { return _data; }
+
+    // Truncated to the capacity
+    void assign(const char* s, size_t n)
+    {
+        _size = size_type(n < N ? n : N);
+        memcpy(_data, s, _size);
+        _data[_size] = '\0';
+    }
+
+    void assign(const char* s)
+    {
+        assign(s, strlen(s));
+    }
+
+    template <typename policy>
+    void method(policy& p)
+    {
+        p % _size;
+
+        if (_size > N)
+            _size = N;
+
+        p.sequence(_data, _size);
+        _data[_size] = '\0';
+    }
+
+private:
+    size_type _size;
+    char _data[N + 1];
+};
+
+}
+
+#endif // DATATRANSFER_BOUNDED_VECTOR_HPP
@@ -24,6 +24,12 @@ public:
         RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_callbacks) = func;
     }
 
+    template <int N>
+    void deregisterHandler()
+    {
+        RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_callbacks) = nullptr;
+    }
+
 protected:
     template <int N, int count>
     struct FunctionHelper
@@ -0,0 +1,176 @@
+#ifndef DATATRANSFER_CONFLATING_CALLBACK_HANDLER_HPP
+#define DATATRANSFER_CONFLATING_CALLBACK_HANDLER_HPP
+
+#include <atomic>
+#include <stdint.h>
+#include <type_traits>
+#include "callback_handler.hpp"
+#include "message_table.hpp"
+#include "protocol_traits.hpp"
+#include "seqlock.hpp"
+
+namespace datatransfer {
+
+// Wraps another callback handler and conflates the message types whose
+// data<N> sets conflate = true. Their newest value is kept in a seqlock
+// slot that any thread can read with latest<N>(), and handlers run at most
+// once per type per received batch from dispatchPending(), which
+// p2p_connector calls after each chunk it parses. Other types are passed
+// straight through.
+template <typename serialization_policy,
+          typename handler_type = callback_handler<serialization_policy>>
+class conflating_callback_handler
+{
+    template <int N>
+    using data_type = typename serialization_policy::template data<N>::type;
+
+    template <int N>
+    using conflated = conflate_of<typename serialization_policy::template data<N>>;
+
+public:
+    template <int N>
+    using function_type = typename handler_type::template function_type<N>;
+
+    conflating_callback_handler()
+        : _pending(false)
+    {}
+
+    template <int N>
+    void signal(const data_type<N>& t)
+    {
+        signal<N>(t, std::integral_constant<bool, conflated<N>::value>());
+    }
+
+    template <int N>
+    auto registerHandler(function_type<N> func)
+        -> decltype(std::declval<handler_type&>().template registerHandler<N>(func))
+    {
+        return _handlers.template registerHandler<N>(func);
+    }
+
+    template <int N>
+    void deregisterHandler()
+    {
+        _handlers.template deregisterHandler<N>();
+    }
+
+    template <int N, typename subscription>
+    void deregisterHandler(subscription id)
+    {
+        _handlers.template deregisterHandler<N>(id);
+    }
+
+    // Copies the newest value of conflated type N, returns its version (which
+    // grows with every update) or 0 if none was received yet
+    template <int N>
+    uint64_t latest(data_type<N>& t) const
+    {
+        static_assert(conflated<N>::value, "Message type is not conflated");
+
+        return slots().template get<N>().value.load(t);
+    }
+
+    // Runs the handlers of every conflated type updated since the last call
+    // with its newest value
+    void dispatchPending()
+    {
+        if (!_pending.exchange(false, std::memory_order_acquire))
+            return;
+
+        for (int id = 1; id <= serialization_policy::NUMBER_OF_MESSAGES; ++id)
+        {
+            const dispatch_operations& operations = dispatch_table::lookup(id);
+            if (operations.dispatch != nullptr)
+                operations.dispatch(*this);
+        }
+    }
+
+    handler_type& handlers() { return _handlers; }
+
+protected:
+    template <int N, bool = conflated<N>::value>
+    struct Slot {};
+
+    template <int N>
+    struct Slot<N, true>
+    {
+        Slot()
+            : pending(false)
+        {}
+
+        seqlock<data_type<N>> value;
+        std::atomic<bool> pending;
+    };
+
+    template <typename sequence>
+    struct Slots;
+
+    template <int ...N>
+    struct Slots<message_sequence<N...>> : Slot<N>...
+    {
+        template <int id>
+        Slot<id>& get() { return *this; }
+
+        template <int id>
+        const Slot<id>& get() const { return *this; }
+    };
+
+    using message_ids = typename make_message_sequence<1, serialization_policy::NUMBER_OF_MESSAGES>::type;
+
+private:
+    struct dispatch_operations
+    {
+        void (*dispatch)(conflating_callback_handler&);
+    };
+
+    template <int N>
+    struct DispatchOperations
+    {
+        static void dispatch(conflating_callback_handler& handler)
+        {
+            auto& slot = handler.slots().template get<N>();
+            if (slot.pending.exchange(false, std::memory_order_acquire))
+            {
+                data_type<N> t;
+                slot.value.load(t);
+                handler._handlers.template signal<N>(t);
+            }
+        }
+
+        static constexpr dispatch_operations make()
+        {
+            return make(std::integral_constant<bool, conflated<N>::value>());
+        }
+
+        static constexpr dispatch_operations make(std::true_type) { return dispatch_operations{ &dispatch }; }
+        static constexpr dispatch_operations make(std::false_type) { return dispatch_operations{ nullptr }; }
+    };
+
+    using dispatch_table = message_table<dispatch_operations, DispatchOperations, message_ids>;
+
+    template <int N>
+    void signal(const data_type<N>& t, std::false_type)
+    {
+        _handlers.template signal<N>(t);
+    }
+
+    template <int N>
+    void signal(const data_type<N>& t, std::true_type)
+    {
+        auto& slot = slots().template get<N>();
+        slot.value.store(t);
+        slot.pending.store(true, std::memory_order_release);
+        _pending.store(true, std::memory_order_release);
+    }
+
+    Slots<message_ids>& slots() { return _slots; }
+    const Slots<message_ids>& slots() const { return _slots; }
+
+    handler_type _handlers;
+    Slots<message_ids> _slots;
+    std::atomic<bool> _pending;
+};
+
+}
+
+#endif // DATATRANSFER_CONFLATING_CALLBACK_HANDLER_HPP
@@ -0,0 +1,164 @@
+#ifndef DATATRANSFER_CONNECTOR_STATS_HPP
+#define DATATRANSFER_CONNECTOR_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+
+namespace datatransfer {
+
+enum stat_counter
+{
+    BYTES_IN,
+    BYTES_OUT,
+    // Bytes discarded while hunting for SYNC_1
+    BYTES_SKIPPED,
+    // SYNC_1 not followed by SYNC_2
+    SYNC_LOSSES,
+    UNKNOWN_IDS,
+    // Payloads larger than the receive buffer or of the wrong fixed size
+    OVERSIZE_DROPS,
+    DECODE_FAILURES,
+    CHECKSUM_FAILURES,
+    // Reliable frames sent again and reliable frames received twice
+    RETRANSMITS,
+    DUPLICATES,
+    STAT_COUNTER_COUNT
+};
+
+// Stats policy for p2p_connector that records nothing. Every call is an
+// empty inline function, so the instrumentation compiles away.
+struct no_stats
+{
+    struct snapshot_type {};
+    using time_point = int;
+
+    void add(stat_counter, size_t = 1) {}
+    void frameReceived(int) {}
+    void frameSent(int) {}
+
+    static time_point now() { return 0; }
+    void handlerFinished(time_point) {}
+    void sendFinished(time_point) {}
+
+    snapshot_type snapshot() const { return snapshot_type(); }
+};
+
+// Power of two buckets of nanoseconds: bucket i counts durations in
+// [2^i, 2^(i+1)) ns, bucket 0 also takes anything shorter
+class latency_histogram
+{
+public:
+    enum
+    {
+        BUCKETS = 40
+    };
+
+    latency_histogram()
+    {
+        for (auto& bucket : _buckets)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+
+    void record(uint64_t ns)
+    {
+        int i = 0;
+        while (ns > 1 && i < BUCKETS - 1)
+        {
+            ns >>= 1;
+            ++i;
+        }
+
+        _buckets[i].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void snapshot(uint64_t (&out)[BUCKETS]) const
+    {
+        for (int i = 0; i < BUCKETS; ++i)
+            out[i] = _buckets[i].load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> _buckets[BUCKETS];
+};
+
+// Stats policy with relaxed atomic counters, per message ID frame counts and
+// latency histograms for handler execution and the send path. Safe to
+// snapshot from any thread while the connector is running.
+class atomic_stats
+{
+public:
+    enum
+    {
+        MAX_IDS = 256
+    };
+
+    using clock = std::chrono::steady_clock;
+    using time_point = clock::time_point;
+
+    struct snapshot_type
+    {
+        uint64_t counters[STAT_COUNTER_COUNT];
+        uint64_t frames_in[MAX_IDS];
+        uint64_t frames_out[MAX_IDS];
+        uint64_t handler_latency[latency_histogram::BUCKETS];
+        uint64_t send_latency[latency_histogram::BUCKETS];
+
+        uint64_t operator[](stat_counter c) const { return counters[c]; }
+    };
+
+    atomic_stats()
+    {
+        for (auto& counter : _counters)
+            counter.store(0, std::memory_order_relaxed);
+
+        for (int i = 0; i < MAX_IDS; ++i)
+        {
+            _frames_in[i].store(0, std::memory_order_relaxed);
+            _frames_out[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void add(stat_counter c, size_t n = 1) { _counters[c].fetch_add(n, std::memory_order_relaxed); }
+    void frameReceived(int id) { _frames_in[id & (MAX_IDS - 1)].fetch_add(1, std::memory_order_relaxed); }
+    void frameSent(int id) { _frames_out[id & (MAX_IDS - 1)].fetch_add(1, std::memory_order_relaxed); }
+
+    static time_point now() { return clock::now(); }
+    void handlerFinished(time_point start) { _handler_latency.record(elapsed(start)); }
+    void sendFinished(time_point start) { _send_latency.record(elapsed(start)); }
+
+    snapshot_type snapshot() const
+    {
+        snapshot_type s;
+
+        for (int i = 0; i < STAT_COUNTER_COUNT; ++i)
+            s.counters[i] = _counters[i].load(std::memory_order_relaxed);
+
+        for (int i = 0; i < MAX_IDS; ++i)
+        {
+            s.frames_in[i] = _frames_in[i].load(std::memory_order_relaxed);
+            s.frames_out[i] = _frames_out[i].load(std::memory_order_relaxed);
+        }
+
+        _handler_latency.snapshot(s.handler_latency);
+        _send_latency.snapshot(s.send_latency);
+        return s;
+    }
+
+private:
+    static uint64_t elapsed(time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+    }
+
+    std::atomic<uint64_t> _counters[STAT_COUNTER_COUNT];
+    std::atomic<uint64_t> _frames_in[MAX_IDS];
+    std::atomic<uint64_t> _frames_out[MAX_IDS];
+    latency_histogram _handler_latency;
+    latency_histogram _send_latency;
+};
+
+}
+
+#endif // DATATRANSFER_CONNECTOR_STATS_HPP
@@ -0,0 +1,216 @@
+#ifndef DATATRANSFER_CRC_HPP
+#define DATATRANSFER_CRC_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DATATRANSFER_CRC_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace datatransfer {
+
+// CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF, no reflection, no final xor.
+// update() takes and returns the finished CRC so calls can be chained.
+struct crc16_ccitt
+{
+    using value_type = uint16_t;
+
+    static constexpr value_type INITIAL = 0xFFFF;
+
+    static value_type update(value_type crc, const void* data, size_t bytes)
+    {
+        const uint16_t (&t)[8][256] = tables().t;
+        auto p = static_cast<const uint8_t*>(data);
+
+        // Slicing-by-8
+        while (bytes >= 8)
+        {
+            crc = t[7][p[0] ^ (crc >> 8)] ^ t[6][p[1] ^ (crc & 0xFF)]
+                ^ t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+            p += 8;
+            bytes -= 8;
+        }
+
+        while (bytes--)
+            crc = uint16_t(crc << 8) ^ t[0][(crc >> 8) ^ *p++];
+
+        return crc;
+    }
+
+private:
+    struct table
+    {
+        uint16_t t[8][256];
+
+        table()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                uint16_t c = uint16_t(i << 8);
+                for (int bit = 0; bit < 8; ++bit)
+                    c = (c & 0x8000) ? uint16_t((c << 1) ^ 0x1021) : uint16_t(c << 1);
+                t[0][i] = c;
+            }
+
+            // t[k] is the contribution of a byte followed by k zero bytes
+            for (int k = 1; k < 8; ++k)
+                for (int i = 0; i < 256; ++i)
+                    t[k][i] = uint16_t(t[k-1][i] << 8) ^ t[0][t[k-1][i] >> 8];
+        }
+    };
+
+    static const table& tables()
+    {
+        static const table instance;
+        return instance;
+    }
+};
+
+// CRC-32C (Castagnoli): reflected poly 0x82F63B78, init and final xor
+// 0xFFFFFFFF. Uses the SSE4.2 / ARMv8 crc32c instructions when available,
+// slicing-by-8 tables otherwise. update() takes and returns the finished CRC.
+struct crc32c
+{
+    using value_type = uint32_t;
+
+    static constexpr value_type INITIAL = 0;
+
+    static value_type update(value_type crc, const void* data, size_t bytes)
+    {
+        static const update_function implementation = select();
+        return ~implementation(~crc, static_cast<const uint8_t*>(data), bytes);
+    }
+
+    static value_type update_portable(value_type crc, const void* data, size_t bytes)
+    {
+        return ~software(~crc, static_cast<const uint8_t*>(data), bytes);
+    }
+
+private:
+    using update_function = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+    struct table
+    {
+        uint32_t t[8][256];
+
+        table()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1;
+                t[0][i] = c;
+            }
+
+            for (int k = 1; k < 8; ++k)
+                for (int i = 0; i < 256; ++i)
+                    t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xFF];
+        }
+    };
+
+    static const table& tables()
+    {
+        static const table instance;
+        return instance;
+    }
+
+    static uint32_t software(uint32_t crc, const uint8_t* p, size_t bytes)
+    {
+        const uint32_t (&t)[8][256] = tables().t;
+
+        // Slicing-by-8, words are loaded little endian
+        while (bytes >= 8)
+        {
+            uint32_t one, two;
+            memcpy(&one, p, 4);
+            memcpy(&two, p + 4, 4);
+            one ^= crc;
+
+            crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^ t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24]
+                ^ t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^ t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+            p += 8;
+            bytes -= 8;
+        }
+
+        while (bytes--)
+            crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+
+        return crc;
+    }
+
+#if defined(DATATRANSFER_CRC_SSE42)
+    __attribute__((target("sse4.2")))
+    static uint32_t sse42(uint32_t crc, const uint8_t* p, size_t bytes)
+    {
+#if defined(__x86_64__)
+        uint64_t c = crc;
+        while (bytes >= 8)
+        {
+            uint64_t v;
+            memcpy(&v, p, 8);
+            c = _mm_crc32_u64(c, v);
+            p += 8;
+            bytes -= 8;
+        }
+        crc = uint32_t(c);
+#endif
+        while (bytes >= 4)
+        {
+            uint32_t v;
+            memcpy(&v, p, 4);
+            crc = _mm_crc32_u32(crc, v);
+            p += 4;
+            bytes -= 4;
+        }
+
+        while (bytes--)
+            crc = _mm_crc32_u8(crc, *p++);
+
+        return crc;
+    }
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+    static uint32_t armv8(uint32_t crc, const uint8_t* p, size_t bytes)
+    {
+        while (bytes >= 8)
+        {
+            uint64_t v;
+            memcpy(&v, p, 8);
+            crc = __crc32cd(crc, v);
+            p += 8;
+            bytes -= 8;
+        }
+
+        while (bytes--)
+            crc = __crc32cb(crc, *p++);
+
+        return crc;
+    }
+#endif
+
+    static update_function select()
+    {
+#if defined(DATATRANSFER_CRC_SSE42)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.2"))
+            return &sse42;
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+        return &armv8;
+#endif
+        return &software;
+    }
+};
+
+}
+
+#endif // DATATRANSFER_CRC_HPP
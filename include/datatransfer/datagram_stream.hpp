@@ -0,0 +1,162 @@
+#ifndef DATATRANSFER_DATAGRAM_STREAM_HPP
+#define DATATRANSFER_DATAGRAM_STREAM_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+namespace datatransfer {
+
+// Output/input stream over a connected datagram socket (e.g. UDP). Every
+// write() becomes one datagram; datagrams are queued and handed to the
+// kernel with a single sendmmsg() on flush() or when the queue fills up.
+// p2p_connector writes its whole TX buffer at once, so each datagram
+// carries one or several complete frames; the connector refuses to build
+// with a TX buffer larger than MAX_WRITE_SIZE. p2p_connector::send() leaves
+// flushing to the queue filling up or to p2p_connector::flush(), see
+// FLUSH_ON_SEND. receive() pulls up to BATCH datagrams per recvmmsg() and
+// is used through p2p_connector::readDatagrams().
+template <size_t MAX_DATAGRAM_SIZE = 1472, size_t BATCH = 64>
+class datagram_stream
+{
+public:
+    using char_type = char;
+
+    static constexpr size_t MAX_WRITE_SIZE = MAX_DATAGRAM_SIZE;
+    static constexpr bool FLUSH_ON_SEND = false;
+
+    explicit datagram_stream(int fd)
+        : _fd(fd)
+        , _error(false)
+        , _tx_count(0)
+    {}
+
+    int fd() const { return _fd; }
+
+    bool good() const { return !_error; }
+    void clear() { _error = false; }
+
+    datagram_stream& write(const char_type* buf, size_t n)
+    {
+        // The peer's receive() would drop it as truncated
+        if (n > MAX_DATAGRAM_SIZE)
+        {
+            _error = true;
+            return *this;
+        }
+
+        if (_tx_count == BATCH)
+            flush();
+
+        memcpy(_tx[_tx_count], buf, n);
+        _tx_size[_tx_count++] = n;
+        return *this;
+    }
+
+    datagram_stream& flush()
+    {
+        if (_tx_count == 0)
+            return *this;
+
+        iovec iov[BATCH];
+        mmsghdr msgs[BATCH];
+        memset(msgs, 0, sizeof(mmsghdr) * _tx_count);
+
+        for (size_t i = 0; i < _tx_count; ++i)
+        {
+            iov[i].iov_base = _tx[i];
+            iov[i].iov_len = _tx_size[i];
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        sendAll(msgs, _tx_count);
+        _tx_count = 0;
+        return *this;
+    }
+
+    // Calls sink(data, size) for each datagram received by one recvmmsg(),
+    // returns the number received. With wait set, blocks until at least one
+    // datagram arrives. Truncated datagrams are dropped.
+    template <typename sink_type>
+    size_t receive(sink_type&& sink, bool wait = true)
+    {
+        iovec iov[BATCH];
+        mmsghdr msgs[BATCH];
+        memset(msgs, 0, sizeof(msgs));
+
+        for (size_t i = 0; i < BATCH; ++i)
+        {
+            iov[i].iov_base = _rx[i];
+            iov[i].iov_len = MAX_DATAGRAM_SIZE;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n;
+        do
+        {
+            n = recvmmsg(_fd, msgs, BATCH, wait ? MSG_WAITFORONE : MSG_DONTWAIT, nullptr);
+        }
+        while (n < 0 && errno == EINTR);
+
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED)
+                _error = true;
+
+            return 0;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) == 0)
+                sink(reinterpret_cast<const uint8_t*>(_rx[i]), size_t(msgs[i].msg_len));
+        }
+
+        return size_t(n);
+    }
+
+private:
+    void sendAll(mmsghdr* msgs, size_t count)
+    {
+        while (count > 0 && good())
+        {
+            const int n = sendmmsg(_fd, msgs, count, 0);
+            if (n > 0)
+            {
+                msgs += n;
+                count -= size_t(n);
+            }
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                pollfd p = { _fd, POLLOUT, 0 };
+                poll(&p, 1, -1);
+            }
+            else if (n < 0 && errno == ECONNREFUSED)
+            {
+                // Peer not listening (yet), the datagram is lost like any other
+                ++msgs;
+                --count;
+            }
+            else if (n < 0 && errno != EINTR)
+            {
+                _error = true;
+            }
+        }
+    }
+
+    int _fd;
+    bool _error;
+    size_t _tx_count;
+    size_t _tx_size[BATCH];
+    char_type _tx[BATCH][MAX_DATAGRAM_SIZE];
+    char_type _rx[BATCH][MAX_DATAGRAM_SIZE];
+};
+
+}
+
+#endif // DATATRANSFER_DATAGRAM_STREAM_HPP
@@ -0,0 +1,269 @@
+#ifndef DATATRANSFER_DELTA_CODEC_HPP
+#define DATATRANSFER_DELTA_CODEC_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+#include "varint.hpp"
+
+namespace datatransfer {
+
+// Offsets and sizes of the primitive fields visited by T::method(), measured
+// once per type. Types containing variable length sequences have no fixed
+// layout.
+template <typename T>
+class field_layout
+{
+public:
+    struct field
+    {
+        uint16_t offset;
+        uint16_t size;
+    };
+
+    static const field_layout& get()
+    {
+        static const field_layout layout;
+        return layout;
+    }
+
+    size_t size() const { return _count; }
+    bool fixed() const { return _fixed; }
+    const field& operator[](size_t i) const { return _fields[i]; }
+
+private:
+    class visitor
+    {
+    public:
+        visitor(field_layout& layout, const uint8_t* base)
+            : _layout(layout)
+            , _base(base)
+        {}
+
+        template <typename U>
+        visitor& operator% (U& x)
+        {
+            operate(x);
+            return *this;
+        }
+
+        template <typename U>
+        visitor& operator% (varint_field<U> x)
+        {
+            operate(x.value);
+            return *this;
+        }
+
+        template <typename U>
+        visitor& sequence(U*, size_t)
+        {
+            _layout._fixed = false;
+            return *this;
+        }
+
+        template <typename U>
+        void operate(U& x)
+        {
+            operate(x, std::is_arithmetic<U>());
+        }
+
+        template <typename U, size_t N>
+        void operate(U (&x)[N])
+        {
+            for (size_t i = 0; i < N; ++i)
+                operate(x[i]);
+        }
+
+    private:
+        template <typename U>
+        void operate(U& x, std::true_type)
+        {
+            const size_t offset = reinterpret_cast<const uint8_t*>(&x) - _base;
+            _layout._fields[_layout._count++] = field{ uint16_t(offset), uint16_t(sizeof(U)) };
+        }
+
+        template <typename U>
+        void operate(U& x, std::false_type)
+        {
+            x.method(*this);
+        }
+
+        field_layout& _layout;
+        const uint8_t* _base;
+    };
+
+    field_layout()
+        : _count(0)
+        , _fixed(true)
+    {
+        alignas(T) uint8_t storage[sizeof(T)] = {};
+        visitor v(*this, storage);
+        v.operate(*reinterpret_cast<T*>(storage));
+    }
+
+    // Every field occupies at least one byte
+    field _fields[sizeof(T)];
+    size_t _count;
+    bool _fixed;
+};
+
+// Delta payload layout: sequence, kind, then for a keyframe the normally
+// serialized message, for a delta a changed-field bitmask followed by the
+// raw bytes of each changed field
+struct delta_format
+{
+    static constexpr size_t PREFIX_SIZE = 2;
+
+    enum kind : uint8_t
+    {
+        KEYFRAME = 0,
+        DELTA = 1
+    };
+
+    template <typename T>
+    static constexpr size_t mask_size() { return (sizeof(T) + 7) / 8; }
+
+    // Extra bytes a delta encoded payload can take over the plain encoding
+    template <typename T>
+    static constexpr size_t overhead() { return PREFIX_SIZE + mask_size<T>(); }
+};
+
+// Sender side state: the last transmitted value of one message type
+template <typename T>
+class delta_sender
+{
+public:
+    delta_sender()
+        : _sequence(0)
+        , _since_keyframe(0)
+        , _valid(false)
+    {}
+
+    // Advances the sequence and decides whether the next frame is a keyframe
+    bool next(int keyframe_interval)
+    {
+        ++_sequence;
+
+        if (!_valid || !field_layout<T>::get().fixed() || ++_since_keyframe >= keyframe_interval)
+        {
+            _since_keyframe = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    uint8_t sequence() const { return _sequence; }
+
+    template <typename buffer_type>
+    void writeDelta(buffer_type& buffer, const T& t) const
+    {
+        using char_type = typename buffer_type::char_type;
+
+        const field_layout<T>& layout = field_layout<T>::get();
+        auto current = reinterpret_cast<const uint8_t*>(&t);
+
+        uint8_t mask[delta_format::mask_size<T>()] = {};
+        for (size_t i = 0; i < layout.size(); ++i)
+        {
+            if (memcmp(current + layout[i].offset, _last + layout[i].offset, layout[i].size) != 0)
+                mask[i / 8] |= uint8_t(1 << (i % 8));
+        }
+
+        buffer.write(reinterpret_cast<const char_type*>(mask), (layout.size() + 7) / 8);
+
+        // Assume little endian encoding
+        for (size_t i = 0; i < layout.size(); ++i)
+        {
+            if (mask[i / 8] & (1 << (i % 8)))
+                buffer.write(reinterpret_cast<const char_type*>(current + layout[i].offset), layout[i].size);
+        }
+    }
+
+    void remember(const T& t)
+    {
+        memcpy(_last, &t, sizeof(T));
+        _valid = true;
+    }
+
+private:
+    alignas(T) uint8_t _last[sizeof(T)];
+    uint8_t _sequence;
+    int _since_keyframe;
+    bool _valid;
+};
+
+// Receiver side state: the last reconstructed value of one message type
+template <typename T>
+class delta_receiver
+{
+public:
+    delta_receiver()
+        : _sequence(0)
+        , _pending(0)
+        , _valid(false)
+    {}
+
+    void beginKeyframe(uint8_t sequence)
+    {
+        _pending = sequence;
+    }
+
+    // Rebuilds the full message in out from the last value and a delta,
+    // fails if the base value is missing or a frame was lost in between
+    bool applyDelta(uint8_t sequence, const uint8_t* data, size_t bytes, T& out)
+    {
+        if (!_valid || sequence != uint8_t(_sequence + 1))
+        {
+            // Wait for the next keyframe
+            _valid = false;
+            return false;
+        }
+
+        const field_layout<T>& layout = field_layout<T>::get();
+        const size_t mask_bytes = (layout.size() + 7) / 8;
+        if (bytes < mask_bytes)
+            return false;
+
+        const uint8_t* mask = data;
+        const uint8_t* end = data + bytes;
+        data += mask_bytes;
+
+        auto target = reinterpret_cast<uint8_t*>(&out);
+        memcpy(target, _last, sizeof(T));
+
+        for (size_t i = 0; i < layout.size(); ++i)
+        {
+            if (mask[i / 8] & (1 << (i % 8)))
+            {
+                if (size_t(end - data) < layout[i].size)
+                    return false;
+
+                memcpy(target + layout[i].offset, data, layout[i].size);
+                data += layout[i].size;
+            }
+        }
+
+        _pending = sequence;
+        return data == end;
+    }
+
+    // Called once the frame checksum has been verified
+    void commit(const T& t)
+    {
+        memcpy(_last, &t, sizeof(T));
+        _sequence = _pending;
+        _valid = true;
+    }
+
+private:
+    alignas(T) uint8_t _last[sizeof(T)];
+    uint8_t _sequence;
+    uint8_t _pending;
+    bool _valid;
+};
+
+}
+
+#endif // DATATRANSFER_DELTA_CODEC_HPP
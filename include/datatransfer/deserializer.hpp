@@ -27,7 +27,7 @@ public:
     bool operator() (T &t)
 	{
         _read_policy.operate(t);
-        return true;
+        return !_is.failed();
 	}
 };
 
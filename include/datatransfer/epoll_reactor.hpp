@@ -0,0 +1,217 @@
+#ifndef DATATRANSFER_EPOLL_REACTOR_HPP
+#define DATATRANSFER_EPOLL_REACTOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace datatransfer {
+
+// Single threaded event loop feeding many connectors from raw file
+// descriptors. Descriptors are watched edge-triggered and drained in large
+// chunks straight into p2p_connector::feed(), so one thread can serve any
+// number of links. Sending still goes through each connector's own stream,
+// e.g. an fd_stream over the same descriptor.
+//
+// add() and remove() must be called from the loop thread or while the loop
+// is not running; stop() may be called from any thread.
+class epoll_reactor
+{
+public:
+    enum
+    {
+        READ_CHUNK_SIZE = 65536,
+        MAX_EVENTS = 64
+    };
+
+    epoll_reactor()
+        : _epoll(epoll_create1(EPOLL_CLOEXEC))
+        , _wakeup(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        , _stop_requested(false)
+    {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        if (_epoll >= 0 && _wakeup >= 0)
+            epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakeup, &ev);
+    }
+
+    ~epoll_reactor()
+    {
+        if (_wakeup >= 0)
+            close(_wakeup);
+        if (_epoll >= 0)
+            close(_epoll);
+    }
+
+    bool good() const { return _epoll >= 0 && _wakeup >= 0; }
+
+    // Starts feeding data read from fd into c. The descriptor is switched to
+    // non-blocking mode and is not owned.
+    template <typename connector>
+    bool add(int fd, connector& c)
+    {
+        const int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+            return false;
+
+        std::unique_ptr<registration> r(new registration{ fd, &c, &feed<connector> });
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = r.get();
+        if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev) < 0)
+            return false;
+
+        _registrations.push_back(std::move(r));
+
+        // Data that arrived before registration raises no edge
+        service(*_registrations.back());
+        return true;
+    }
+
+    bool remove(int fd)
+    {
+        for (auto& r : _registrations)
+        {
+            if (r->fd == fd)
+            {
+                release(*r);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Number of descriptors still being watched
+    size_t size() const
+    {
+        return std::count_if(_registrations.begin(), _registrations.end(),
+                             [](const std::unique_ptr<registration>& r) { return r->fd >= 0; });
+    }
+
+    // Waits up to timeout_ms for input and services every ready descriptor,
+    // returns the number serviced or -1 on error
+    int runOnce(int timeout_ms = -1)
+    {
+        epoll_event events[MAX_EVENTS];
+
+        const int n = epoll_wait(_epoll, events, MAX_EVENTS, timeout_ms);
+        if (n < 0)
+            return errno == EINTR ? 0 : -1;
+
+        int serviced = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            auto r = static_cast<registration*>(events[i].data.ptr);
+            if (r == nullptr)
+            {
+                uint64_t count;
+                while (::read(_wakeup, &count, sizeof(count)) > 0) {}
+            }
+            else if (r->fd >= 0)
+            {
+                service(*r);
+                ++serviced;
+            }
+        }
+
+        purge();
+        return serviced;
+    }
+
+    // Services descriptors until stop(). A stop() issued before run() is
+    // kept, and run() then returns straight away.
+    void run()
+    {
+        while (!_stop_requested.exchange(false, std::memory_order_acq_rel))
+        {
+            if (runOnce() < 0)
+                break;
+        }
+    }
+
+    void stop()
+    {
+        _stop_requested.store(true, std::memory_order_release);
+
+        const uint64_t one = 1;
+        ssize_t ret = ::write(_wakeup, &one, sizeof(one));
+        (void)ret;
+    }
+
+private:
+    struct registration
+    {
+        int fd;
+        void* connector;
+        void (*feed)(void*, const uint8_t*, size_t);
+    };
+
+    template <typename connector>
+    static void feed(void* c, const uint8_t* data, size_t n)
+    {
+        static_cast<connector*>(c)->feed(data, n);
+    }
+
+    // Edge-triggered: read until the descriptor reports EAGAIN
+    void service(registration& r)
+    {
+        while (r.fd >= 0)
+        {
+            const ssize_t n = ::read(r.fd, _chunk, READ_CHUNK_SIZE);
+            if (n > 0)
+            {
+                r.feed(r.connector, _chunk, size_t(n));
+            }
+            else if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else
+            {
+                // Closed or failed descriptors stop being watched
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                    release(r);
+
+                break;
+            }
+        }
+    }
+
+    // Registrations are freed in purge() so pending events never dangle
+    void release(registration& r)
+    {
+        if (r.fd >= 0)
+        {
+            epoll_ctl(_epoll, EPOLL_CTL_DEL, r.fd, nullptr);
+            r.fd = -1;
+        }
+    }
+
+    void purge()
+    {
+        _registrations.erase(std::remove_if(_registrations.begin(), _registrations.end(),
+                                            [](const std::unique_ptr<registration>& r) { return r->fd < 0; }),
+                             _registrations.end());
+    }
+
+    int _epoll;
+    int _wakeup;
+    std::atomic<bool> _stop_requested;
+    std::vector<std::unique_ptr<registration>> _registrations;
+    uint8_t _chunk[READ_CHUNK_SIZE];
+};
+
+}
+
+#endif // DATATRANSFER_EPOLL_REACTOR_HPP
@@ -0,0 +1,117 @@
+#ifndef DATATRANSFER_FD_STREAM_HPP
+#define DATATRANSFER_FD_STREAM_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace datatransfer {
+
+// Minimal input_output_stream over a raw file descriptor (pipe, pty, socket,
+// serial tty). The descriptor is switched to non-blocking mode: readsome()
+// never blocks, get() and write() wait with poll() when the descriptor is
+// not ready. The descriptor is not owned.
+class fd_stream
+{
+public:
+    using char_type = char;
+
+    explicit fd_stream(int fd)
+        : _fd(fd)
+        , _eof(false)
+        , _error(false)
+    {
+        const int flags = fcntl(_fd, F_GETFL);
+        if (flags < 0 || fcntl(_fd, F_SETFL, flags | O_NONBLOCK) < 0)
+            _error = true;
+    }
+
+    int fd() const { return _fd; }
+
+    bool good() const { return !_eof && !_error; }
+    bool eof() const { return _eof; }
+
+    void clear()
+    {
+        _eof = false;
+        _error = false;
+    }
+
+    // Returns the number of bytes read, 0 if nothing is available
+    size_t readsome(char_type* buf, size_t n)
+    {
+        for (;;)
+        {
+            const ssize_t r = ::read(_fd, buf, n);
+            if (r > 0)
+                return size_t(r);
+
+            if (r == 0)
+                _eof = true;
+            else if (errno == EINTR)
+                continue;
+            else if (errno != EAGAIN && errno != EWOULDBLOCK)
+                _error = true;
+
+            return 0;
+        }
+    }
+
+    int get()
+    {
+        char_type c;
+        while (good())
+        {
+            if (readsome(&c, 1) == 1)
+                return static_cast<unsigned char>(c);
+
+            if (good())
+                wait(POLLIN);
+        }
+
+        return -1;
+    }
+
+    fd_stream& write(const char_type* buf, size_t n)
+    {
+        while (n > 0 && good())
+        {
+            const ssize_t w = ::write(_fd, buf, n);
+            if (w >= 0)
+            {
+                buf += w;
+                n -= size_t(w);
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                wait(POLLOUT);
+            }
+            else if (errno != EINTR)
+            {
+                _error = true;
+            }
+        }
+
+        return *this;
+    }
+
+    fd_stream& flush() { return *this; }
+
+private:
+    void wait(short events)
+    {
+        pollfd p = { _fd, events, 0 };
+        if (poll(&p, 1, -1) < 0 && errno != EINTR)
+            _error = true;
+    }
+
+    int _fd;
+    bool _eof;
+    bool _error;
+};
+
+}
+
+#endif // DATATRANSFER_FD_STREAM_HPP
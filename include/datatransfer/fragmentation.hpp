@@ -0,0 +1,113 @@
+#ifndef DATATRANSFER_FRAGMENTATION_HPP
+#define DATATRANSFER_FRAGMENTATION_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+namespace datatransfer {
+
+// Control frames travel with message id 0 and need length_packet_header.
+// The first payload byte is the control type. A COMPRESSED payload is the
+// type byte followed by a whole frame packed with lz_codec.
+struct control_frame
+{
+    static constexpr int ID = 0;
+
+    enum type : uint8_t
+    {
+        FRAGMENT = 1,
+        ACK = 2,
+        RELIABLE = 3,
+        COMPRESSED = 4
+    };
+};
+
+// Fragment payload: FRAGMENT, priority level, index, flags, then a slice of
+// the original frame bytes (header, payload and checksum). The receiver
+// parses the rebuilt frame as if it had arrived in one piece, so the
+// original checksum still covers it end to end.
+struct fragment_format
+{
+    static constexpr size_t PREFIX_SIZE = 4;
+
+    enum flags : uint8_t
+    {
+        FIRST = 1,
+        LAST = 2
+    };
+};
+
+// One rebuild buffer per priority level; a level only ever has a single
+// fragmented frame in flight
+template <size_t levels, size_t frame_size>
+class fragment_reassembly
+{
+public:
+    fragment_reassembly()
+    {
+        for (size_t i = 0; i < levels; ++i)
+            _slots[i].active = false;
+    }
+
+    // Returns the complete frame once the last fragment arrived, nullptr
+    // otherwise. Out of order or missing fragments drop the frame.
+    const uint8_t* add(const uint8_t* fragment, size_t bytes, size_t& frame_bytes)
+    {
+        if (bytes < fragment_format::PREFIX_SIZE || fragment[1] >= levels)
+            return nullptr;
+
+        slot& s = _slots[fragment[1]];
+        const uint8_t index = fragment[2];
+        const uint8_t flags = fragment[3];
+
+        fragment += fragment_format::PREFIX_SIZE;
+        bytes -= fragment_format::PREFIX_SIZE;
+
+        if (flags & fragment_format::FIRST)
+        {
+            s.active = true;
+            s.size = 0;
+            s.next_index = 0;
+        }
+
+        if (!s.active || index != s.next_index || bytes > frame_size - s.size)
+        {
+            s.active = false;
+            return nullptr;
+        }
+
+        memcpy(&s.data[s.size], fragment, bytes);
+        s.size += bytes;
+        ++s.next_index;
+
+        if ((flags & fragment_format::LAST) == 0)
+            return nullptr;
+
+        s.active = false;
+        frame_bytes = s.size;
+        return s.data;
+    }
+
+private:
+    struct slot
+    {
+        uint8_t data[frame_size];
+        size_t size;
+        uint8_t next_index;
+        bool active;
+    };
+
+    slot _slots[levels];
+};
+
+template <size_t frame_size>
+class fragment_reassembly<0, frame_size>
+{
+public:
+    const uint8_t* add(const uint8_t*, size_t, size_t&) { return nullptr; }
+};
+
+}
+
+#endif // DATATRANSFER_FRAGMENTATION_HPP
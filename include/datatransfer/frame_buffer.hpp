@@ -0,0 +1,72 @@
+#ifndef DATATRANSFER_FRAME_BUFFER_HPP
+#define DATATRANSFER_FRAME_BUFFER_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+namespace datatransfer {
+
+// Fixed capacity output stream that frames are serialized into before
+// being handed to the real stream in a single write.
+template <typename char_type_t, size_t N>
+class frame_buffer
+{
+public:
+    using char_type = char_type_t;
+
+    frame_buffer()
+        : _size(0)
+        , _overflow(false)
+    {}
+
+    void clear()
+    {
+        _size = 0;
+        _overflow = false;
+    }
+
+    // Drops everything after the first size bytes
+    void truncate(size_t size)
+    {
+        if (size < _size)
+            _size = size;
+    }
+
+    size_t size() const { return _size; }
+    size_t remaining() const { return N - _size; }
+    bool empty() const { return _size == 0; }
+
+    // Set by a write that did not fit, the contents are then incomplete
+    // and must not be sent
+    bool overflowed() const { return _overflow; }
+
+    static constexpr size_t capacity() { return N; }
+
+    char_type* data() { return _data; }
+    const char_type* data() const { return _data; }
+
+    // Callers size N for the largest frame they write, so running out of
+    // room is a bug. Nothing is written rather than part of a frame.
+    void write(const char_type* buf, size_t bytes)
+    {
+        assert(bytes <= N - _size && "frame_buffer overflow");
+        if (bytes > N - _size)
+        {
+            _overflow = true;
+            return;
+        }
+
+        memcpy(&_data[_size], buf, bytes * sizeof(char_type));
+        _size += bytes;
+    }
+
+private:
+    char_type _data[N];
+    size_t _size;
+    bool _overflow;
+};
+
+}
+
+#endif // DATATRANSFER_FRAME_BUFFER_HPP
@@ -0,0 +1,167 @@
+#ifndef DATATRANSFER_INPLACE_FUNCTION_HPP
+#define DATATRANSFER_INPLACE_FUNCTION_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace datatransfer {
+
+template <typename signature, size_t capacity = 32>
+class inplace_function;
+
+// std::function replacement that stores the callable inside a fixed size
+// buffer and never allocates. Callables that do not fit fail to compile.
+// Calling goes through a single function pointer.
+template <typename R, typename ...Args, size_t capacity>
+class inplace_function<R(Args...), capacity>
+{
+    using storage_type = typename std::aligned_storage<capacity, alignof(std::max_align_t)>::type;
+
+    struct operations
+    {
+        void (*copy)(storage_type& to, const storage_type& from);
+        void (*move)(storage_type& to, storage_type& from);
+        void (*destroy)(storage_type& s);
+    };
+
+    template <typename F>
+    struct Operations
+    {
+        static R invoke(const storage_type& s, Args... args)
+        {
+            return (*const_cast<F*>(reinterpret_cast<const F*>(&s)))(std::forward<Args>(args)...);
+        }
+
+        static void copy(storage_type& to, const storage_type& from)
+        {
+            new (&to) F(*reinterpret_cast<const F*>(&from));
+        }
+
+        static void move(storage_type& to, storage_type& from)
+        {
+            new (&to) F(std::move(*reinterpret_cast<F*>(&from)));
+        }
+
+        static void destroy(storage_type& s)
+        {
+            reinterpret_cast<F*>(&s)->~F();
+        }
+
+        static const operations table;
+    };
+
+public:
+    inplace_function()
+        : _invoke(nullptr)
+        , _operations(nullptr)
+    {}
+
+    inplace_function(std::nullptr_t)
+        : inplace_function()
+    {}
+
+    template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, inplace_function>::value>::type>
+    inplace_function(F&& f)
+    {
+        using type = typename std::decay<F>::type;
+
+        static_assert(sizeof(type) <= capacity, "Callable does not fit the inplace_function capacity");
+        static_assert(alignof(type) <= alignof(storage_type), "Callable alignment exceeds inplace_function storage");
+
+        new (&_storage) type(std::forward<F>(f));
+        _invoke = &Operations<type>::invoke;
+        _operations = &Operations<type>::table;
+    }
+
+    inplace_function(const inplace_function& other)
+        : _invoke(other._invoke)
+        , _operations(other._operations)
+    {
+        if (_operations != nullptr)
+            _operations->copy(_storage, other._storage);
+    }
+
+    inplace_function(inplace_function&& other)
+        : _invoke(other._invoke)
+        , _operations(other._operations)
+    {
+        if (_operations != nullptr)
+            _operations->move(_storage, other._storage);
+    }
+
+    ~inplace_function()
+    {
+        reset();
+    }
+
+    inplace_function& operator=(const inplace_function& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other._operations != nullptr)
+                other._operations->copy(_storage, other._storage);
+
+            _invoke = other._invoke;
+            _operations = other._operations;
+        }
+
+        return *this;
+    }
+
+    inplace_function& operator=(inplace_function&& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other._operations != nullptr)
+                other._operations->move(_storage, other._storage);
+
+            _invoke = other._invoke;
+            _operations = other._operations;
+        }
+
+        return *this;
+    }
+
+    inplace_function& operator=(std::nullptr_t)
+    {
+        reset();
+        return *this;
+    }
+
+    R operator()(Args... args) const
+    {
+        return _invoke(_storage, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const { return _invoke != nullptr; }
+
+    friend bool operator==(const inplace_function& f, std::nullptr_t) { return !f; }
+    friend bool operator!=(const inplace_function& f, std::nullptr_t) { return static_cast<bool>(f); }
+
+private:
+    void reset()
+    {
+        if (_operations != nullptr)
+            _operations->destroy(_storage);
+
+        _invoke = nullptr;
+        _operations = nullptr;
+    }
+
+    storage_type _storage;
+    R (*_invoke)(const storage_type&, Args...);
+    const operations* _operations;
+};
+
+template <typename R, typename ...Args, size_t capacity>
+template <typename F>
+const typename inplace_function<R(Args...), capacity>::operations
+inplace_function<R(Args...), capacity>::Operations<F>::table = { &copy, &move, &destroy };
+
+}
+
+#endif // DATATRANSFER_INPLACE_FUNCTION_HPP
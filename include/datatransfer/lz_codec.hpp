@@ -0,0 +1,221 @@
+#ifndef DATATRANSFER_LZ_CODEC_HPP
+#define DATATRANSFER_LZ_CODEC_HPP
+
+// POSIX <climits> defines MAX_INPUT, included so a clash shows up here
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+namespace datatransfer {
+
+// Fast byte oriented LZ77 in the LZ4 block layout. Each sequence is a token
+// (literal count in the high nibble, match length - 4 in the low nibble,
+// 15 meaning more length bytes follow, each adding up to 255), the
+// literals, then a 16 bit little endian match offset. The last sequence
+// carries literals only.
+//
+// Matches are found through a single entry hash table of 2^hash_bits
+// positions kept on the stack while compressing. Inputs are limited to
+// 64 KiB, which covers any frame with a 16 bit length field.
+template <int hash_bits = 12>
+struct lz_codec
+{
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t MAX_INPUT_SIZE = 65535;
+
+    // Compresses in into out, returns the compressed size or 0 if it would
+    // not fit in capacity bytes
+    static size_t compress(const uint8_t* in, size_t n, uint8_t* out, size_t capacity)
+    {
+        if (n > MAX_INPUT_SIZE)
+            return 0;
+
+        uint16_t table[1 << hash_bits];
+        memset(table, 0, sizeof(table));
+
+        uint8_t* op = out;
+        uint8_t* const oend = out + capacity;
+        size_t anchor = 0;
+        size_t i = 0;
+
+        while (i + MIN_MATCH <= n)
+        {
+            const uint32_t sequence = read32(in + i);
+            uint16_t& slot = table[hash(sequence)];
+            const size_t candidate = slot;
+            slot = uint16_t(i);
+
+            if (candidate < i && read32(in + candidate) == sequence)
+            {
+                size_t length = MIN_MATCH;
+                while (i + length < n && in[candidate + length] == in[i + length])
+                    ++length;
+
+                if (!writeSequence(op, oend, in + anchor, i - anchor, i - candidate, length))
+                    return 0;
+
+                i += length;
+                anchor = i;
+            }
+            else
+            {
+                // Step faster through data that does not compress
+                i += 1 + ((i - anchor) >> 5);
+            }
+        }
+
+        if (!writeLiterals(op, oend, in + anchor, n - anchor))
+            return 0;
+
+        return op - out;
+    }
+
+    // Returns the decompressed size, 0 if in is malformed or the output
+    // would exceed capacity bytes
+    static size_t decompress(const uint8_t* in, size_t n, uint8_t* out, size_t capacity)
+    {
+        const uint8_t* ip = in;
+        const uint8_t* const iend = in + n;
+        uint8_t* op = out;
+        uint8_t* const oend = out + capacity;
+
+        while (ip != iend)
+        {
+            const uint8_t token = *ip++;
+
+            size_t literals = token >> 4;
+            if (!readLength(ip, iend, literals)
+                || literals > size_t(iend - ip)
+                || literals > size_t(oend - op))
+                return 0;
+
+            memcpy(op, ip, literals);
+            ip += literals;
+            op += literals;
+
+            if (ip == iend)
+                break;
+
+            if (iend - ip < 2)
+                return 0;
+
+            const size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+
+            size_t length = token & 15;
+            if (!readLength(ip, iend, length))
+                return 0;
+
+            length += MIN_MATCH;
+            if (offset == 0 || offset > size_t(op - out) || length > size_t(oend - op))
+                return 0;
+
+            // Matches may overlap their own output
+            const uint8_t* match = op - offset;
+            if (offset >= length)
+            {
+                memcpy(op, match, length);
+                op += length;
+            }
+            else
+            {
+                while (length-- > 0)
+                    *op++ = *match++;
+            }
+        }
+
+        return op - out;
+    }
+
+private:
+    static uint32_t read32(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint32_t hash(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - hash_bits);
+    }
+
+    static bool writeLength(uint8_t*& op, uint8_t* oend, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            if (op == oend)
+                return false;
+
+            *op++ = 255;
+        }
+
+        if (op == oend)
+            return false;
+
+        *op++ = uint8_t(length);
+        return true;
+    }
+
+    static bool readLength(const uint8_t*& ip, const uint8_t* iend, size_t& length)
+    {
+        if (length != 15)
+            return true;
+
+        uint8_t b;
+        do
+        {
+            if (ip == iend)
+                return false;
+
+            b = *ip++;
+            length += b;
+        } while (b == 255);
+
+        return true;
+    }
+
+    static bool writeToken(uint8_t*& op, uint8_t* oend, size_t literals, size_t match)
+    {
+        if (op == oend)
+            return false;
+
+        *op++ = uint8_t(((literals < 15 ? literals : 15) << 4) | (match < 15 ? match : 15));
+
+        return literals < 15 || writeLength(op, oend, literals - 15);
+    }
+
+    static bool writeLiterals(uint8_t*& op, uint8_t* oend, const uint8_t* literals, size_t count)
+    {
+        if (!writeToken(op, oend, count, 0) || count > size_t(oend - op))
+            return false;
+
+        // An empty input may come as a null pointer
+        if (count > 0)
+            memcpy(op, literals, count);
+
+        op += count;
+        return true;
+    }
+
+    static bool writeSequence(uint8_t*& op, uint8_t* oend, const uint8_t* literals, size_t count, size_t offset, size_t length)
+    {
+        const size_t match = length - MIN_MATCH;
+
+        if (!writeToken(op, oend, count, match) || count + 2 > size_t(oend - op))
+            return false;
+
+        memcpy(op, literals, count);
+        op += count;
+
+        *op++ = uint8_t(offset);
+        *op++ = uint8_t(offset >> 8);
+
+        return match < 15 || writeLength(op, oend, match - 15);
+    }
+};
+
+}
+
+#endif // DATATRANSFER_LZ_CODEC_HPP
@@ -0,0 +1,70 @@
+#ifndef DATATRANSFER_MESSAGE_TABLE_HPP
+#define DATATRANSFER_MESSAGE_TABLE_HPP
+
+#include <cstddef>
+
+namespace datatransfer {
+
+template <int ...N>
+struct message_sequence {};
+
+// Builds message_sequence<first, first+1, ..., first+count-1>
+template <int first, int count, int ...N>
+struct make_message_sequence
+    : make_message_sequence<first, count-1, first+count-1, N...>
+{};
+
+template <int first, int ...N>
+struct make_message_sequence<first, 0, N...>
+{
+    using type = message_sequence<N...>;
+};
+
+constexpr size_t static_max(size_t a) { return a; }
+
+template <typename ...T>
+constexpr size_t static_max(size_t a, size_t b, T ...rest)
+{
+    return static_max(a > b ? a : b, rest...);
+}
+
+// Largest value of trait<N>::value over a message_sequence
+template <template <int> class trait,
+          typename sequence>
+struct message_max;
+
+template <template <int> class trait,
+          int ...N>
+struct message_max<trait, message_sequence<N...>>
+{
+    static constexpr size_t value = static_max(trait<N>::value...);
+};
+
+// Constant-initialised table with one entry per message id, built from
+// entry_builder<N>::make(). Lookup is a single indexed load irrespective
+// of the number of messages.
+template <typename entry_type,
+          template <int> class entry_builder,
+          typename sequence>
+struct message_table;
+
+template <typename entry_type,
+          template <int> class entry_builder,
+          int first,
+          int ...N>
+struct message_table<entry_type, entry_builder, message_sequence<first, N...>>
+{
+    static constexpr int size() { return 1 + sizeof...(N); }
+
+    static constexpr bool contains(int id) { return id >= first && id < first + size(); }
+
+    static const entry_type& lookup(int id)
+    {
+        static constexpr entry_type table[] = { entry_builder<first>::make(), entry_builder<N>::make()... };
+        return table[id - first];
+    }
+};
+
+}
+
+#endif // DATATRANSFER_MESSAGE_TABLE_HPP
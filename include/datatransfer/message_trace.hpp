@@ -0,0 +1,187 @@
+#ifndef DATATRANSFER_MESSAGE_TRACE_HPP
+#define DATATRANSFER_MESSAGE_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+#include "connector_stats.hpp"
+
+namespace datatransfer {
+
+// Send timestamps are steady_clock microseconds truncated to 32 bits, so
+// latencies are computed modulo about 71 minutes. One-way latency is only
+// meaningful when both ends read the same monotonic clock, e.g. processes
+// on one host.
+struct trace_clock
+{
+    static uint32_t now()
+    {
+        return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+};
+
+struct trace_snapshot
+{
+    uint64_t received;
+    // Sequence numbers skipped, less those that turned up late
+    uint64_t lost;
+    uint64_t duplicates;
+    // Frames that arrived after a later sequence number
+    uint64_t reordered;
+    uint64_t latency[latency_histogram::BUCKETS];
+};
+
+// Stamps each outgoing frame with the next sequence number of its message
+// ID and the send time. Safe to call from several sending threads.
+template <bool enabled, int max_id>
+class trace_sender
+{
+public:
+    trace_sender()
+    {
+        for (auto& sequence : _next)
+            sequence.store(0, std::memory_order_relaxed);
+    }
+
+    template <typename header_type>
+    void stamp(header_type& header, int id)
+    {
+        header.sequence = _next[id].fetch_add(1, std::memory_order_relaxed);
+        header.timestamp = trace_clock::now();
+    }
+
+private:
+    std::atomic<uint16_t> _next[max_id + 1];
+};
+
+// Tracks the sequence numbers received per message ID over a 64 frame
+// window to tell losses, duplicates and late frames apart. Updated by the
+// reading thread only, snapshots may be taken from any thread.
+template <bool enabled, int max_id>
+class trace_receiver
+{
+public:
+    enum
+    {
+        WINDOW = 64
+    };
+
+    template <typename header_type>
+    void record(const header_type& header)
+    {
+        const int id = header.id;
+        if (id <= 0 || id > max_id)
+            return;
+
+        trace& t = _traces[id];
+
+        // Clocks that are slightly apart must not show up as huge latencies
+        const int32_t elapsed = int32_t(trace_clock::now() - header.timestamp);
+        t.latency.record(elapsed > 0 ? uint64_t(elapsed) * 1000 : 0);
+        t.received.fetch_add(1, std::memory_order_relaxed);
+
+        const int16_t ahead = int16_t(header.sequence - t.highest);
+        if (!t.started || ahead <= -WINDOW)
+        {
+            // First frame, or the sender restarted its sequence numbers
+            t.started = true;
+            t.highest = header.sequence;
+            t.seen = 1;
+            t.span = 1;
+        }
+        else if (ahead > 0)
+        {
+            if (ahead > 1)
+                t.lost.fetch_add(ahead - 1, std::memory_order_relaxed);
+
+            t.seen = ahead < WINDOW ? (t.seen << ahead) | 1 : 1;
+            t.highest = header.sequence;
+            t.span = t.span + ahead < WINDOW ? t.span + ahead : WINDOW;
+        }
+        else if (-ahead >= t.span)
+        {
+            // Sent before the first frame seen, it was never counted as lost
+            t.reordered.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            const uint64_t bit = uint64_t(1) << -ahead;
+            if (t.seen & bit)
+            {
+                t.duplicates.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                t.seen |= bit;
+                t.lost.fetch_sub(1, std::memory_order_relaxed);
+                t.reordered.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    trace_snapshot snapshot(int id) const
+    {
+        trace_snapshot s = {};
+        if (id <= 0 || id > max_id)
+            return s;
+
+        const trace& t = _traces[id];
+        s.received = t.received.load(std::memory_order_relaxed);
+        s.lost = t.lost.load(std::memory_order_relaxed);
+        s.duplicates = t.duplicates.load(std::memory_order_relaxed);
+        s.reordered = t.reordered.load(std::memory_order_relaxed);
+        t.latency.snapshot(s.latency);
+        return s;
+    }
+
+private:
+    struct trace
+    {
+        trace()
+            : received(0)
+            , lost(0)
+            , duplicates(0)
+            , reordered(0)
+            , started(false)
+            , highest(0)
+            , seen(0)
+            , span(0)
+        {}
+
+        std::atomic<uint64_t> received;
+        std::atomic<uint64_t> lost;
+        std::atomic<uint64_t> duplicates;
+        std::atomic<uint64_t> reordered;
+        latency_histogram latency;
+        bool started;
+        uint16_t highest;
+        uint64_t seen;
+        int span;
+    };
+
+    trace _traces[max_id + 1];
+};
+
+template <int max_id>
+class trace_sender<false, max_id>
+{
+public:
+    template <typename header_type>
+    void stamp(header_type&, int) {}
+};
+
+template <int max_id>
+class trace_receiver<false, max_id>
+{
+public:
+    template <typename header_type>
+    void record(const header_type&) {}
+
+    trace_snapshot snapshot(int) const { return trace_snapshot(); }
+};
+
+}
+
+#endif // DATATRANSFER_MESSAGE_TRACE_HPP
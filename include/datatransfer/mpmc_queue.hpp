@@ -0,0 +1,120 @@
+#ifndef DATATRANSFER_MPMC_QUEUE_HPP
+#define DATATRANSFER_MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+namespace datatransfer {
+
+// Bounded lock-free multi-producer/multi-consumer ring (D. Vyukov). Elements
+// are written and read in place through the functors passed to
+// try_push()/try_pop(), so nothing is copied twice.
+template <typename element_type, size_t N>
+class mpmc_queue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Queue size must be a power of two");
+
+    struct alignas(64) cell
+    {
+        std::atomic<size_t> sequence;
+        element_type value;
+    };
+
+public:
+    mpmc_queue()
+        : _enqueue_pos(0)
+        , _dequeue_pos(0)
+    {
+        for (size_t i = 0; i < N; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    template <typename writer>
+    bool try_push(writer&& write)
+    {
+        size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        cell* c;
+
+        for (;;)
+        {
+            c = &_cells[pos & (N - 1)];
+            const size_t sequence = c->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+
+            if (diff == 0)
+            {
+                if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // Full
+                return false;
+            }
+            else
+            {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        write(c->value);
+        c->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    template <typename reader>
+    bool try_pop(reader&& read)
+    {
+        size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        cell* c;
+
+        for (;;)
+        {
+            c = &_cells[pos & (N - 1)];
+            const size_t sequence = c->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+
+            if (diff == 0)
+            {
+                if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // Empty
+                return false;
+            }
+            else
+            {
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        read(c->value);
+        c->sequence.store(pos + N, std::memory_order_release);
+
+        return true;
+    }
+
+    // Approximate number of queued elements
+    size_t size() const
+    {
+        const size_t enqueued = _enqueue_pos.load(std::memory_order_relaxed);
+        const size_t dequeued = _dequeue_pos.load(std::memory_order_relaxed);
+
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+    cell _cells[N];
+    alignas(64) std::atomic<size_t> _enqueue_pos;
+    alignas(64) std::atomic<size_t> _dequeue_pos;
+};
+
+}
+
+#endif // DATATRANSFER_MPMC_QUEUE_HPP
@@ -1,9 +1,25 @@
 #ifndef DATATRANSFER_P2P_CONNECTOR_HPP
 #define DATATRANSFER_P2P_CONNECTOR_HPP
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdio>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include "binary_serialization.hpp"
 #include "serializer.hpp"
 #include "deserializer.hpp"
+#include "message_table.hpp"
+#include "frame_buffer.hpp"
+#include "protocol_traits.hpp"
+#include "delta_codec.hpp"
+#include "connector_stats.hpp"
+#include "fragmentation.hpp"
+#include "reliable_delivery.hpp"
+#include "lz_codec.hpp"
+#include "message_trace.hpp"
 
 namespace datatransfer {
 
@@ -21,143 +37,408 @@ public:
 template<typename mutex,
          typename input_output_stream,
          typename serialization_policy,
-         typename callback_handler_type>
+         typename callback_handler_type,
+         size_t tx_buffer_size = 1024,
+         typename stats_policy = no_stats>
 class p2p_connector
+    // Private bases rather than members so the empty no_stats and the trace
+    // state of untraced headers take no space
+    : private stats_policy
+    , private trace_sender<header_type_of<serialization_policy>::type::HAS_TRACE, serialization_policy::NUMBER_OF_MESSAGES>
+    , private trace_receiver<header_type_of<serialization_policy>::type::HAS_TRACE, serialization_policy::NUMBER_OF_MESSAGES>
 {
-    using write_policy = typename serialization_policy::template serialization<input_output_stream>::write_policy;
+    using char_type = typename input_output_stream::char_type;
     using read_policy = typename serialization_policy::template serialization<input_output_stream>::read_policy;
     using checksum_policy = typename serialization_policy::template serialization<input_output_stream>::checksum_policy;
     using size_policy = typename serialization_policy::template serialization<input_output_stream>::size_policy;
 
-    template<int N,
-             int Count>
-    struct SizeHelper
+    using checksum_type = typename checksum_policy::data_type;
+    using header_type = typename header_type_of<serialization_policy>::type;
+    using input_stream = typename deserializer<read_policy>::input_stream;
+
+    // Has size 1 if the compiler lays out an empty stats_policy base in no space
+    struct empty_base_check : stats_policy { char c; };
+
+protected:
+    template <int N>
+    struct DeltaMode
+    {
+        static constexpr int keyframe_interval = keyframe_interval_of<typename serialization_policy::template data<N>>::value;
+        static constexpr bool value = keyframe_interval > 0;
+    };
+
+private:
+    // Per message type delta coding state, empty unless the type is in delta mode
+    template <int N, bool = DeltaMode<N>::value>
+    struct DeltaState {};
+
+    template <int N>
+    struct DeltaState<N, true>
+    {
+        delta_sender<typename serialization_policy::template data<N>::type> sender;
+        delta_receiver<typename serialization_policy::template data<N>::type> receiver;
+    };
+
+    template <typename sequence>
+    struct DeltaStates;
+
+    template <int ...N>
+    struct DeltaStates<message_sequence<N...>> : DeltaState<N>... {};
+
+    struct message_operations
+    {
+        size_t (*size)();
+        // Longest payload a well behaved peer sends with this id
+        size_t max_size;
+        bool in_place;
+        bool (*deserialize)(p2p_connector&);
+        void (*callback)(p2p_connector&);
+    };
+
+    template <int N>
+    struct MessageOperations
     {
-        static size_t size(int id, uint8_t data[serialization_policy::MAX_MESSAGE_SIZE])
+        using type = typename serialization_policy::template data<N>::type;
+        using delta_mode = std::integral_constant<bool, DeltaMode<N>::value>;
+
+        static_assert(sizeof(type) <= serialization_policy::MAX_MESSAGE_SIZE, "Message type exceeds MAX_MESSAGE_SIZE");
+        static_assert(!delta_mode::value || header_type::HAS_LENGTH, "Delta mode requires length_packet_header");
+        static_assert(fixed_width_of<size_policy>::value || header_type::HAS_LENGTH,
+                      "Variable width encodings require length_packet_header");
+
+        // Received straight into the parse buffer, bypassing the deserializer
+        static constexpr bool in_place = read_policy::template bitwise<type>::value && !delta_mode::value;
+
+        static size_t size()
         {
-            if (N == id)
-            {
-                using type = typename serialization_policy::template data<N>::type;
+            requireFixedSize<type>(std::integral_constant<bool, !header_type::HAS_LENGTH>());
+            return size_policy::template wire_size<type>();
+        }
 
-                type* t = reinterpret_cast<type*>(data);
-                size_policy s;
-                s.operate(*t);
-                return s.size();
-            }
-            else
+        static bool deserialize(p2p_connector& connector)
+        {
+            return deserialize(connector, delta_mode());
+        }
+
+        static void callback(p2p_connector& connector)
+        {
+            callback(connector, delta_mode());
+        }
+
+        static constexpr message_operations make()
+        {
+            return message_operations{ &size, PayloadSizeBound<N>::value, in_place, &deserialize, &callback };
+        }
+
+    private:
+        static bool deserialize(p2p_connector& connector, std::false_type)
+        {
+            if (serialization_policy::template data<N>::length > 0)
+                return connector._deserializer(reinterpret_cast<type&>(*connector._parse_buffer));
+
+            return true;
+        }
+
+        static bool deserialize(p2p_connector& connector, std::true_type)
+        {
+            input_stream& is = connector._input_stream;
+            if (size_t(is.size()) < delta_format::PREFIX_SIZE)
+                return false;
+
+            auto payload = reinterpret_cast<const uint8_t*>(is.data);
+            auto& receiver = connector.template deltaState<N>().receiver;
+            auto& message = reinterpret_cast<type&>(*connector._parse_buffer);
+
+            if (payload[1] == delta_format::KEYFRAME)
             {
-                return SizeHelper<N+1, Count-1>::size(id, data);
+                receiver.beginKeyframe(payload[0]);
+                is.consume(delta_format::PREFIX_SIZE);
+                return connector._deserializer(message);
             }
+
+            is.consume(is.size());
+            return payload[1] == delta_format::DELTA
+                && receiver.applyDelta(payload[0], payload + delta_format::PREFIX_SIZE, is.size() - delta_format::PREFIX_SIZE, message);
+        }
+
+        static void callback(p2p_connector& connector, std::false_type)
+        {
+            connector._message_handlers.template signal<N>(reinterpret_cast<const type&>(*connector._parse_buffer));
+        }
+
+        static void callback(p2p_connector& connector, std::true_type)
+        {
+            const type& message = reinterpret_cast<const type&>(*connector._parse_buffer);
+            connector.template deltaState<N>().receiver.commit(message);
+            connector._message_handlers.template signal<N>(message);
+        }
+    };
+
+    using message_ids = typename make_message_sequence<1, serialization_policy::NUMBER_OF_MESSAGES>::type;
+    using operation_table = message_table<message_operations, MessageOperations, message_ids>;
+
+    // Control frames are staged like any other payload and handled once
+    // their checksum has been verified
+    struct ControlOperations
+    {
+        static size_t size() { return 0; }
+
+        static bool deserialize(p2p_connector& connector)
+        {
+            connector._input_stream.consume(connector._input_stream.size());
+            return true;
+        }
+
+        static void callback(p2p_connector& connector)
+        {
+            connector.controlReceived();
+        }
+
+        static constexpr message_operations make()
+        {
+            return message_operations{ &size, MIN_STAGING_SIZE, false, &deserialize, &callback };
         }
     };
 
+    static const message_operations& lookupOperations(int id)
+    {
+        static constexpr message_operations control = ControlOperations::make();
+
+        return id == control_frame::ID ? control : operation_table::lookup(id);
+    }
+
+    // Without a length field the receiver frames payloads by their measured
+    // size, which variable length messages do not have
+    template <typename T>
+    static void requireFixedSize(std::false_type) {}
+
+    template <typename T>
+    static void requireFixedSize(std::true_type)
+    {
+        (void)&fixed_size_check::template visit<T>;
+    }
+
     template <int N>
-    struct SizeHelper<N,0>
+    struct PayloadSizeBound
     {
-        static size_t size(int, uint8_t[]) { return 0; }
+        using type = typename serialization_policy::template data<N>::type;
+
+        // A delta never carries more field bytes than the plain encoding
+        static constexpr size_t value = size_policy::template wire_size_bound<type>()
+                                        + (DeltaMode<N>::value ? delta_format::overhead<type>() : 0);
     };
 
-    template<int N,
-             int Count>
-    struct CallbackHelper
+    template <int N>
+    struct ObjectSize
     {
-        static void callback(const typename checksum_policy::data_type& checksum,
-                             packet<uint8_t[serialization_policy::MAX_MESSAGE_SIZE], checksum_policy>& rx_packet,
-                             callback_handler_type& message_handlers)
-        {
-            if (N == rx_packet.header.id)
-            {
-                using type = typename serialization_policy::template data<N>::type;
+        static constexpr size_t value = sizeof(typename serialization_policy::template data<N>::type);
+    };
 
-                packet<type, checksum_policy> decoded_packet(reinterpret_cast<type&>(rx_packet.data), rx_packet.header.id);
+    template <int N>
+    struct ObjectAlignment
+    {
+        static constexpr size_t value = alignof(typename serialization_policy::template data<N>::type);
+    };
 
-                if (checksum == decoded_packet.calculate_crc())
-                {
-                    message_handlers.template signal<N>(reinterpret_cast<const type&>(rx_packet.data));
-                }
-            }
-            else
-            {
-                CallbackHelper<N+1,Count-1>::callback(checksum, rx_packet, message_handlers);
-            }
-        }
+    template <int N>
+    struct StagedSizeBound
+    {
+        static constexpr size_t value = MessageOperations<N>::in_place ? 0 : PayloadSizeBound<N>::value;
     };
 
-    template<int N>
-    struct CallbackHelper<N,0>
+    template <int N>
+    struct Reliable : reliable_of<typename serialization_policy::template data<N>> {};
+
+    template <int N>
+    struct ReliableFrameBound
     {
-        static void callback(const typename checksum_policy::data_type&,
-                             packet<uint8_t[serialization_policy::MAX_MESSAGE_SIZE], checksum_policy>&,
-                             callback_handler_type&)
-        {}
+        static constexpr size_t value = Reliable<N>::value
+            ? header_type::SIZE + PayloadSizeBound<N>::value + sizeof(checksum_type)
+            : 0;
     };
 
-    template<int N,
-             int Count>
-    struct DeserializeHelper
+public:
+    static constexpr size_t MAX_PAYLOAD_SIZE = message_max<PayloadSizeBound, message_ids>::value;
+    static constexpr size_t MAX_FRAME_SIZE = header_type::SIZE + MAX_PAYLOAD_SIZE + sizeof(checksum_type);
+
+    static_assert(MAX_PAYLOAD_SIZE <= serialization_policy::MAX_MESSAGE_SIZE, "Largest message exceeds MAX_MESSAGE_SIZE");
+    static_assert(MAX_PAYLOAD_SIZE <= header_type::MAX_PAYLOAD_LENGTH, "Largest message does not fit the header length field");
+    static_assert(message_max<StagedSizeBound, message_ids>::value <= size_t(input_stream::capacity()),
+                  "read_policy buffer is too small for the largest message that is not received in place");
+
+    static constexpr int PRIORITY_LEVELS = priority_levels_of<serialization_policy>::value;
+    static constexpr size_t FRAGMENT_SIZE = fragment_size_of<serialization_policy>::value;
+
+    static_assert(PRIORITY_LEVELS >= 1 && PRIORITY_LEVELS <= 256, "PRIORITY_LEVELS must be between 1 and 256");
+    static_assert(FRAGMENT_SIZE == 0 || header_type::HAS_LENGTH, "Fragmentation requires length_packet_header");
+    static_assert(FRAGMENT_SIZE == 0 || fragment_format::PREFIX_SIZE + FRAGMENT_SIZE <= size_t(input_stream::capacity()),
+                  "read_policy buffer is too small for a fragment");
+    static_assert(FRAGMENT_SIZE == 0 || fragment_format::PREFIX_SIZE + FRAGMENT_SIZE <= header_type::MAX_PAYLOAD_LENGTH,
+                  "Fragment does not fit the header length field");
+
+    static constexpr size_t RELIABLE_WINDOW = reliable_window_of<serialization_policy>::value;
+    static constexpr size_t RELIABLE_FRAME_SIZE = message_max<ReliableFrameBound, message_ids>::value;
+
+    static_assert(RELIABLE_FRAME_SIZE == 0 || RELIABLE_WINDOW > 0, "Reliable messages require a RELIABLE_WINDOW");
+    static_assert(RELIABLE_FRAME_SIZE == 0 || header_type::HAS_LENGTH, "Reliable messages require length_packet_header");
+    static_assert(RELIABLE_FRAME_SIZE == 0 || reliable_format::DATA_PREFIX_SIZE + RELIABLE_FRAME_SIZE <= size_t(input_stream::capacity()),
+                  "read_policy buffer is too small for a reliable frame");
+    static_assert(RELIABLE_FRAME_SIZE == 0 || reliable_format::DATA_PREFIX_SIZE + RELIABLE_FRAME_SIZE <= header_type::MAX_PAYLOAD_LENGTH,
+                  "Reliable frame does not fit the header length field");
+
+    // Control frames wrap a fragment or a whole reliable frame and can be
+    // larger than any message frame, the transmit buffer must hold them all
+    static constexpr size_t MAX_TX_FRAME_SIZE = static_max(MAX_FRAME_SIZE,
+        FRAGMENT_SIZE != 0 ? header_type::SIZE + fragment_format::PREFIX_SIZE + FRAGMENT_SIZE + sizeof(checksum_type) : 0,
+        RELIABLE_FRAME_SIZE != 0 ? header_type::SIZE + reliable_format::DATA_PREFIX_SIZE + RELIABLE_FRAME_SIZE + sizeof(checksum_type) : 0,
+        RELIABLE_FRAME_SIZE != 0 ? header_type::SIZE + reliable_format::ackSize(RELIABLE_WINDOW) + sizeof(checksum_type) : 0);
+    static constexpr size_t TX_BUFFER_SIZE = static_max(tx_buffer_size, MAX_TX_FRAME_SIZE);
+
+    static_assert(TX_BUFFER_SIZE <= max_write_size_of<input_output_stream>::value,
+                  "Largest frame or tx_buffer_size exceeds the stream's MAX_WRITE_SIZE");
+
+    static constexpr size_t COMPRESSION_THRESHOLD = compression_threshold_of<serialization_policy>::value;
+
+    static_assert(COMPRESSION_THRESHOLD == 0 || header_type::HAS_LENGTH, "Compression requires length_packet_header");
+    static_assert(COMPRESSION_THRESHOLD == 0 || MAX_FRAME_SIZE <= lz_codec<>::MAX_INPUT_SIZE, "Frames are too large to compress");
+
+    // Decoded messages and in place payloads share one buffer, sized and
+    // aligned for the largest message type rather than MAX_MESSAGE_SIZE
+    static constexpr size_t PARSE_BUFFER_SIZE = message_max<ObjectSize, message_ids>::value;
+    static constexpr size_t PARSE_BUFFER_ALIGNMENT = message_max<ObjectAlignment, message_ids>::value;
+
+    // Smallest read_policy buffer that holds every staged payload and
+    // control frame this protocol can receive
+    static constexpr size_t MIN_STAGING_SIZE = static_max(
+        message_max<StagedSizeBound, message_ids>::value,
+        FRAGMENT_SIZE != 0 ? fragment_format::PREFIX_SIZE + FRAGMENT_SIZE : 0,
+        RELIABLE_FRAME_SIZE != 0 ? reliable_format::DATA_PREFIX_SIZE + RELIABLE_FRAME_SIZE : 0,
+        RELIABLE_FRAME_SIZE != 0 ? reliable_format::ackSize(RELIABLE_WINDOW) : 0,
+        COMPRESSION_THRESHOLD != 0 ? MAX_PAYLOAD_SIZE : 0);
+
+    static_assert(MIN_STAGING_SIZE <= size_t(input_stream::capacity()), "read_policy buffer is too small for a control frame");
+
+    // Largest frame a well behaved peer can send us
+    static constexpr size_t MAX_RX_FRAME_SIZE = static_max(MAX_FRAME_SIZE,
+        header_type::SIZE + MIN_STAGING_SIZE + sizeof(checksum_type));
+    static constexpr size_t RESYNC_LOOKBACK = resync_lookback_of<serialization_policy, MAX_RX_FRAME_SIZE>::value;
+
+    static_assert(RESYNC_LOOKBACK > 0, "RESYNC_LOOKBACK must be greater than 0");
+
+private:
+    using tx_buffer_type = frame_buffer<char_type, TX_BUFFER_SIZE>;
+    using reliable_window = std::integral_constant<size_t, RELIABLE_FRAME_SIZE != 0 ? RELIABLE_WINDOW : 0>;
+    using reliable_clock = typename reliable_sender<reliable_window::value, RELIABLE_FRAME_SIZE>::clock;
+    using reassembly_type = fragment_reassembly<FRAGMENT_SIZE != 0 ? PRIORITY_LEVELS : 0, MAX_FRAME_SIZE>;
+    using reliable_sender_type = reliable_sender<reliable_window::value, RELIABLE_FRAME_SIZE>;
+    using reliable_receiver_type = reliable_receiver<reliable_window::value, RELIABLE_FRAME_SIZE>;
+    using trace_sender_type = trace_sender<header_type::HAS_TRACE, serialization_policy::NUMBER_OF_MESSAGES>;
+    using trace_receiver_type = trace_receiver<header_type::HAS_TRACE, serialization_policy::NUMBER_OF_MESSAGES>;
+
+    struct empty_trace_check : trace_sender_type, trace_receiver_type { char c; };
+
+    struct no_window_wait { void notify_all() {} };
+    using window_wait_type = typename std::conditional<RELIABLE_FRAME_SIZE != 0,
+        std::condition_variable_any, no_window_wait>::type;
+
+    // State of protocol features, empty for features the protocol does not
+    // use. Nested types cannot be bases of the connector itself, as bases
+    // of a single member the empty ones still take no space.
+    struct feature_state
+        : DeltaStates<message_ids>
+        , reassembly_type
+        , reliable_sender_type
+        , reliable_receiver_type
+        , window_wait_type
+    {};
+
+public:
+    // Bytes taken by each buffer of a connector, for budgeting memory.
+    // total() adds the handler table, locks and parser state.
+    struct memory_footprint
     {
-        bool static deserializeType(int data_type, deserializer<read_policy>& deserializer, uint8_t* read_buffer, uint8_t c)
-        {
-            if (N == data_type )
-            {
-                if (serialization_policy::template data<N>::length > 0)
-                {
-                    return deserializer(reinterpret_cast<typename serialization_policy::template data<N>::type&>(*read_buffer));
-                }
-            }
-            else
-            {
-                return DeserializeHelper<N+1,Count-1>::deserializeType(data_type, deserializer, read_buffer, c);
-            }
-        }
+        static constexpr size_t TX_BUFFER = sizeof(tx_buffer_type);
+        static constexpr size_t PARSE_BUFFER = PARSE_BUFFER_SIZE;
+        static constexpr size_t STAGING_BUFFER = sizeof(input_stream);
+        static constexpr size_t RESYNC_BUFFER = RESYNC_LOOKBACK;
+        static constexpr size_t COMPRESSION_BUFFER = COMPRESSION_THRESHOLD != 0 ? MAX_FRAME_SIZE : 0;
+        static constexpr size_t DELTA_STATE = std::is_empty<DeltaStates<message_ids>>::value ? 0 : sizeof(DeltaStates<message_ids>);
+        static constexpr size_t FRAGMENT_BUFFERS = std::is_empty<reassembly_type>::value ? 0 : sizeof(reassembly_type);
+        static constexpr size_t RELIABLE_BUFFERS = (std::is_empty<reliable_sender_type>::value ? 0 : sizeof(reliable_sender_type))
+                                                 + (std::is_empty<reliable_receiver_type>::value ? 0 : sizeof(reliable_receiver_type));
+        static constexpr size_t TRACE_STATE = (std::is_empty<trace_sender_type>::value ? 0 : sizeof(trace_sender_type))
+                                            + (std::is_empty<trace_receiver_type>::value ? 0 : sizeof(trace_receiver_type));
+        static constexpr size_t STATS = std::is_empty<stats_policy>::value ? 0 : sizeof(stats_policy);
+
+        static constexpr size_t total() { return sizeof(p2p_connector); }
     };
 
-    template<int N>
-    struct DeserializeHelper<N, 0>
+private:
+
+    enum
     {
-        bool static deserializeType(uint8_t, deserializer<read_policy>&, uint8_t*, uint8_t)
-        {
-            // Invalid data type
-            return false;
-        }
+        READ_BLOCK_SIZE = 512
     };
 
     enum parse_state
     {
         WAIT_FOR_SYNC_1,
         WAIT_FOR_SYNC_2,
-        WAIT_FOR_ID,
+        WAIT_FOR_HEADER,
         WAIT_FOR_DATA,
-        WAIT_FOR_CRC
+        WAIT_FOR_DATA_IN_PLACE,
+        WAIT_FOR_CRC,
+        SKIP_FRAME
     };
 
 protected:
     mutex _send_mutex;
+    tx_buffer_type _tx_buffer;
     input_output_stream& _iostream;
     callback_handler_type _message_handlers;
-    packet<uint8_t[serialization_policy::MAX_MESSAGE_SIZE], checksum_policy> _rx_packet;
-    uint8_t _parse_buffer[serialization_policy::MAX_MESSAGE_SIZE];
-    typename deserializer<read_policy>::input_stream _input_stream;
-    uint8_t _payload_size;
+    header_type _rx_header;
+    uint8_t _rx_header_bytes[header_type::SIZE];
+    checksum_type _rx_checksum;
+    alignas(PARSE_BUFFER_ALIGNMENT) uint8_t _parse_buffer[PARSE_BUFFER_SIZE];
+    input_stream _input_stream;
+    size_t _payload_size;
+    size_t _received;
+    size_t _rejected_bytes;
     parse_state _parse_state;
+    bool _ack_pending;
+    bool _decompressing;
+    feature_state _features;
     deserializer<read_policy> _deserializer;
+    uint8_t _replay[RESYNC_LOOKBACK];
+    uint8_t _decompressed[COMPRESSION_THRESHOLD != 0 ? MAX_FRAME_SIZE : 1];
 
 public:
     p2p_connector(input_output_stream& stream)
         : _iostream(stream)
-        , _rx_packet(_parse_buffer)
+        , _rejected_bytes(0)
         , _parse_state(WAIT_FOR_SYNC_1)
+        , _ack_pending(false)
+        , _decompressing(false)
         , _deserializer(_input_stream)
-    {}
+    {
+        static_assert(sizeof(p2p_connector) <= max_connector_size_of<serialization_policy>::value,
+                      "p2p_connector exceeds serialization_policy::MAX_CONNECTOR_SIZE");
+        static_assert(!std::is_empty<stats_policy>::value || sizeof(empty_base_check) == 1,
+                      "An empty stats_policy must not add to the connector size");
+        static_assert(header_type::HAS_TRACE || sizeof(empty_trace_check) == 1,
+                      "Untraced headers must not add trace state to the connector size");
+    }
 
     ~p2p_connector() {}
 
+    // Returns whatever the handler type returns, e.g. a subscription handle
     template<int T>
-    void registerMessageHandler(typename callback_handler_type::template function_type<T> handler)
+    auto registerMessageHandler(typename callback_handler_type::template function_type<T> handler)
+        -> decltype(std::declval<callback_handler_type&>().template registerHandler<T>(handler))
     {
         static_assert(serialization_policy::valid(T), "T is not a valid message type");
 
-        _message_handlers.template registerHandler<T>(handler);
+        return _message_handlers.template registerHandler<T>(handler);
     }
 
     template<int T>
@@ -165,27 +446,113 @@ public:
     {
         static_assert(serialization_policy::valid(T), "T is not a valid message type");
 
-        //_message_handlers[T-1] = nullptr;
+        _message_handlers.template deregisterHandler<T>();
     }
 
-    template<int T>
-    void send(typename serialization_policy::template data<T>::type& data)
+    // Removes a single subscriber from handler types that support several
+    template<int T, typename subscription>
+    void deregisterMessageHandler(subscription id)
     {
         static_assert(serialization_policy::valid(T), "T is not a valid message type");
-        using data_type = typename serialization_policy::template data<T>::type;
 
-        MutexLocker<mutex> locker(_send_mutex);
+        _message_handlers.template deregisterHandler<T>(id);
+    }
 
-        if (_iostream.good())
+    // For handler types that need setting up, e.g. starting worker threads
+    callback_handler_type& messageHandlers() { return _message_handlers; }
+
+    // Holds the send lock and packs every frame sent through it into as few
+    // stream writes as possible, flushing once on commit()
+    class batch
+    {
+    public:
+        explicit batch(p2p_connector& connector)
+            : _connector(&connector)
+        {
+            _connector->_send_mutex.lock();
+        }
+
+        batch(batch&& other)
+            : _connector(other._connector)
         {
-            packet<data_type, checksum_policy> p(data, T);
-            p.footer.checksum = p.calculate_crc();
+            other._connector = nullptr;
+        }
 
-            serializer<write_policy> s(_iostream);
-            s(p);
+        ~batch() { commit(); }
 
-            _iostream.flush();
+        template<int T>
+        void send(typename serialization_policy::template data<T>::type& data)
+        {
+            static_assert(serialization_policy::valid(T), "T is not a valid message type");
+            static_assert(!Reliable<T>::value, "Reliable messages are sent with p2p_connector::send()");
+
+            if (_connector != nullptr)
+                _connector->template bufferFrame<T>(data);
+        }
+
+        void commit()
+        {
+            if (_connector != nullptr)
+            {
+                _connector->writeBuffer();
+                _connector->flushStream();
+                _connector->_send_mutex.unlock();
+                _connector = nullptr;
+            }
         }
+
+    private:
+        batch(const batch&) = delete;
+        batch& operator=(const batch&) = delete;
+
+        p2p_connector* _connector;
+    };
+
+    // Reliable messages wait while the send window is full. Acknowledgements
+    // only come in through read()/readDatagrams(), so another thread must be
+    // reading the stream meanwhile. Returns false if the window stayed full
+    // for SEND_TIMEOUT_MS and the message was not sent.
+    template<int T>
+    bool send(typename serialization_policy::template data<T>::type& data)
+    {
+        static_assert(serialization_policy::valid(T), "T is not a valid message type");
+
+        const auto start = stats_policy::now();
+        const bool sent = send<T>(data, std::integral_constant<bool, Reliable<T>::value>());
+        statsPolicy().sendFinished(start);
+
+        return sent;
+    }
+
+    // Flushes the stream, needed after send() with streams that queue writes
+    // until told to, see flush_on_send_of
+    void flush()
+    {
+        MutexLocker<mutex> locker(_send_mutex);
+
+        flushStream();
+    }
+
+    // Resends reliable frames whose acknowledgement is overdue, call it
+    // periodically; returns the number of frames resent
+    size_t retransmit()
+    {
+        MutexLocker<mutex> locker(_send_mutex);
+
+        return resendDue();
+    }
+
+    // Reliable frames sent but not acknowledged yet
+    size_t unacknowledged()
+    {
+        MutexLocker<mutex> locker(_send_mutex);
+
+        return reliableTx().inFlight();
+    }
+
+    batch beginBatch()
+    {
+        return batch(*this);
     }
 
     void readOnce()
@@ -195,86 +562,872 @@ public:
             int c;
             if ((c = _iostream.get()) >= 0)
             {
-                processChar(c);
+                const uint8_t byte = uint8_t(c);
+                statsPolicy().add(BYTES_IN);
+                parse(&byte, 1);
+                parseFinished();
             }
         }
     }
 
     void read()
     {
-        if (_iostream.good())
+        uint8_t block[READ_BLOCK_SIZE];
+
+        while (_iostream.good())
         {
-            int c;
-            while ((c = _iostream.get()) >= 0)
+            const size_t n = readSome(_iostream, block, READ_BLOCK_SIZE, 0);
+            if (n > 0)
+            {
+                feed(block, n);
+            }
+            else
             {
-                processChar(c);
+                // Nothing buffered, fall back to a (possibly blocking) single byte read
+                int c;
+                if ((c = _iostream.get()) < 0)
+                    break;
+
+                const uint8_t byte = uint8_t(c);
+                statsPolicy().add(BYTES_IN);
+                parse(&byte, 1);
+                parseFinished();
             }
         }
     }
 
-private:
+    void feed(const uint8_t* data, size_t len)
+    {
+        statsPolicy().add(BYTES_IN, len);
+        parse(data, len);
+        parseFinished();
+    }
 
-    void processChar(int c)
+    // Parses a datagram holding one or more whole frames back to back. Frame
+    // boundaries are known, so there is no sync hunting; a malformed frame
+    // discards the rest of the datagram.
+    void feedDatagram(const uint8_t* data, size_t len)
     {
-        switch (_parse_state)
+        const uint8_t* const end = data + len;
+
+        statsPolicy().add(BYTES_IN, len);
+        _parse_state = WAIT_FOR_SYNC_1;
+
+        while (size_t(end - data) >= header_type::SIZE)
         {
-            case WAIT_FOR_SYNC_1:
-                if (c == _rx_packet.header.SYNC_1)
-                    _parse_state = WAIT_FOR_SYNC_2;
-            break;
-            case WAIT_FOR_SYNC_2:
-                if (c == _rx_packet.header.SYNC_2)
-                    _parse_state = WAIT_FOR_ID;
-                else
-                    _parse_state = WAIT_FOR_SYNC_1;
-            break;
-            case WAIT_FOR_ID:
-            {
-                if (!serialization_policy::valid(c))
-                {
-                    // Silently fail on error
-                    _parse_state = WAIT_FOR_SYNC_1;
-                }
-                else
-                {
-                    _rx_packet.header.id = c;
-                    _deserializer.reset();
-                    SizeHelper<1, serialization_policy::NUMBER_OF_MESSAGES> helper;
-                    _payload_size = helper.size(_rx_packet.header.id, _rx_packet.data);
-                    _input_stream.clear();
-                    if (_payload_size > serialization_policy::MAX_MESSAGE_SIZE)
-                    {
-                        _parse_state = WAIT_FOR_SYNC_1;
-                    }
-                    else
-                    {
-                        _parse_state = WAIT_FOR_DATA;
-                    }
-                }
-            }
-            break;
-            case WAIT_FOR_DATA:
+            if (data[0] != _rx_header.SYNC_1 || data[1] != _rx_header.SYNC_2)
+                break;
+
+            memcpy(_rx_header_bytes, data, header_type::SIZE);
+            _rx_header.decode(_rx_header_bytes);
+
+            const size_t frame_size = datagramFrameSize();
+            if (frame_size == 0 || frame_size > size_t(end - data))
+                break;
+
+            headerReceived();
+            if (_rejected_bytes != 0)
             {
-                _input_stream.receive(c);
-                if (_input_stream.size() == _payload_size)
-                {
-                    DeserializeHelper<1, serialization_policy::NUMBER_OF_MESSAGES> helper;
-                    if (helper.deserializeType(_rx_packet.header.id, _deserializer, _parse_buffer, c))
-                    {
-                        _parse_state = WAIT_FOR_CRC;
-                    }
-                    else
-                    {
-                        _parse_state = WAIT_FOR_SYNC_1;
-                    }
-                }
+                _rejected_bytes = 0;
+                break;
             }
-            break;
-            case WAIT_FOR_CRC:
-            {
-                CallbackHelper<1, serialization_policy::NUMBER_OF_MESSAGES> helper;
-                helper.callback(c, _rx_packet, _message_handlers);
-                _parse_state = WAIT_FOR_SYNC_1;
+
+            parse(data + header_type::SIZE, frame_size - header_type::SIZE);
+            _parse_state = WAIT_FOR_SYNC_1;
+
+            data += frame_size;
+        }
+
+        parseFinished();
+    }
+
+    // Receives a batch of datagrams from a datagram stream such as
+    // datagram_stream and parses each one, returns the number received
+    size_t readDatagrams(bool wait = true)
+    {
+        return _iostream.receive([this](const uint8_t* data, size_t len) { feedDatagram(data, len); }, wait);
+    }
+
+    typename stats_policy::snapshot_type stats() const
+    {
+        return statsPolicy().snapshot();
+    }
+
+    // Loss, duplication and latency of message ID id as seen by this end,
+    // all zero unless the header type is a traced_header
+    trace_snapshot trace(int id) const
+    {
+        return traceRx().snapshot(id);
+    }
+
+protected:
+    stats_policy& statsPolicy() { return *this; }
+    const stats_policy& statsPolicy() const { return *this; }
+
+    reassembly_type& reassembly() { return _features; }
+    reliable_sender_type& reliableTx() { return _features; }
+    reliable_receiver_type& reliableRx() { return _features; }
+    window_wait_type& windowOpen() { return _features; }
+
+    trace_sender_type& traceTx() { return *this; }
+    trace_receiver_type& traceRx() { return *this; }
+    const trace_receiver_type& traceRx() const { return *this; }
+
+    template<int T, typename buffer_type>
+    void serializeFrame(buffer_type& buffer, typename serialization_policy::template data<T>::type& data)
+    {
+        static_assert(!DeltaMode<T>::value, "Delta mode messages are serialized with serializeMessage()");
+
+        using write_policy = typename serialization_policy::template serialization<buffer_type>::write_policy;
+        using type = typename serialization_policy::template data<T>::type;
+
+        requireFixedSize<type>(std::integral_constant<bool, !header_type::HAS_LENGTH>());
+
+        const size_t start = beginFrame(buffer, messageHeader<T>());
+
+        serializer<write_policy> s(buffer);
+        s(data);
+
+        endFrame(buffer, start);
+    }
+
+    // Serializes through the delta coder for delta mode messages, which
+    // updates the per type sender state; callers serialize access to it.
+    // Large frames are then compressed when that is enabled.
+    template<int T, typename buffer_type>
+    void serializeMessage(buffer_type& buffer, typename serialization_policy::template data<T>::type& data)
+    {
+        const size_t start = buffer.size();
+
+        statsPolicy().frameSent(T);
+        serializeMessage<T>(buffer, data, std::integral_constant<bool, DeltaMode<T>::value>());
+
+        if (COMPRESSION_THRESHOLD != 0 && buffer.size() - start >= COMPRESSION_THRESHOLD)
+            compressFrame(buffer, start);
+    }
+
+    // The following require _send_mutex to be held
+
+    template<int T>
+    void bufferFrame(typename serialization_policy::template data<T>::type& data)
+    {
+        if (_tx_buffer.remaining() < MAX_FRAME_SIZE)
+            writeBuffer();
+
+        serializeMessage<T>(_tx_buffer, data);
+    }
+
+    // Writes a control frame whose payload is prefix followed by data. Only
+    // valid with a length header, the features that send control frames
+    // check for it.
+    void bufferControlFrame(const uint8_t* prefix, size_t prefix_size, const char_type* data, size_t bytes)
+    {
+        if (_tx_buffer.remaining() < header_type::SIZE + prefix_size + bytes + sizeof(checksum_type))
+            writeBuffer();
+
+        const size_t start = beginFrame(_tx_buffer, header_type(control_frame::ID));
+        _tx_buffer.write(reinterpret_cast<const char_type*>(prefix), prefix_size);
+        _tx_buffer.write(data, bytes);
+        endFrame(_tx_buffer, start);
+    }
+
+    void bufferBytes(const char_type* data, size_t bytes)
+    {
+        if (_tx_buffer.remaining() < bytes)
+            writeBuffer();
+
+        _tx_buffer.write(data, bytes);
+    }
+
+    void writeBuffer()
+    {
+        if (!_tx_buffer.empty() && !_tx_buffer.overflowed() && _iostream.good())
+        {
+            _iostream.write(_tx_buffer.data(), _tx_buffer.size());
+            statsPolicy().add(BYTES_OUT, _tx_buffer.size());
+        }
+
+        _tx_buffer.clear();
+    }
+
+    void flushStream()
+    {
+        if (_iostream.good())
+            _iostream.flush();
+    }
+
+private:
+    template<int T>
+    bool send(typename serialization_policy::template data<T>::type& data, std::false_type)
+    {
+        MutexLocker<mutex> locker(_send_mutex);
+
+        bufferFrame<T>(data);
+        writeBuffer();
+        if (flush_on_send_of<input_output_stream>::value)
+            flushStream();
+
+        return true;
+    }
+
+    // The send lock is released while waiting so the read side can take in
+    // acknowledgements, which wake us up. Overdue frames are resent at least
+    // every retransmit timeout, otherwise a lost frame or acknowledgement
+    // would stall the sender for good when nobody calls retransmit().
+    template<int T>
+    bool send(typename serialization_policy::template data<T>::type& data, std::true_type)
+    {
+        const auto deadline = reliable_clock::now() + sendTimeout();
+
+        MutexLocker<mutex> locker(_send_mutex);
+        while (!bufferReliableFrame<T>(data))
+        {
+            resendDue();
+
+            const auto now = reliable_clock::now();
+            if (now >= deadline)
+                return false;
+
+            windowOpen().wait_until(_send_mutex, std::min<typename reliable_clock::time_point>(deadline, now + retransmitTimeout()));
+        }
+
+        writeBuffer();
+        flushStream();
+
+        return true;
+    }
+
+    // The following require _send_mutex to be held
+
+    template<int T>
+    bool bufferReliableFrame(typename serialization_policy::template data<T>::type& data)
+    {
+        if (reliableTx().full())
+            return false;
+
+        // Kept until acknowledged, the window has room for the largest reliable frame
+        frame_buffer<char_type, RELIABLE_FRAME_SIZE> frame;
+        serializeMessage<T>(frame, data);
+
+        auto bytes = reinterpret_cast<const uint8_t*>(frame.data());
+        const uint16_t seq = reliableTx().push(bytes, frame.size(), reliable_clock::now() + retransmitTimeout());
+        bufferReliableFrame(seq, bytes, frame.size());
+
+        return true;
+    }
+
+    void bufferReliableFrame(uint16_t seq, const uint8_t* frame, size_t bytes)
+    {
+        uint8_t prefix[reliable_format::DATA_PREFIX_SIZE] = { control_frame::RELIABLE };
+        reliable_format::encodeSequence(prefix + 1, reliableTx().epoch());
+        reliable_format::encodeSequence(prefix + 3, seq);
+
+        bufferControlFrame(prefix, reliable_format::DATA_PREFIX_SIZE, reinterpret_cast<const char_type*>(frame), bytes);
+    }
+
+    size_t resendDue()
+    {
+        auto resend = [this](uint16_t seq, const uint8_t* frame, size_t bytes)
+        {
+            bufferReliableFrame(seq, frame, bytes);
+        };
+
+        const size_t frames = reliableTx().retransmit(reliable_clock::now(), retransmitTimeout(), resend);
+        if (frames > 0)
+        {
+            statsPolicy().add(RETRANSMITS, frames);
+            writeBuffer();
+            flushStream();
+        }
+
+        return frames;
+    }
+
+    static constexpr std::chrono::milliseconds retransmitTimeout()
+    {
+        return std::chrono::milliseconds(retransmit_timeout_of<serialization_policy>::value);
+    }
+
+    static constexpr std::chrono::milliseconds sendTimeout()
+    {
+        return std::chrono::milliseconds(send_timeout_of<serialization_policy>::value);
+    }
+
+    // Header of the next frame of message T, stamped when tracing
+    template <int T>
+    header_type messageHeader()
+    {
+        header_type header(T);
+        traceTx().stamp(header, T);
+        return header;
+    }
+
+    template <typename buffer_type>
+    static size_t beginFrame(buffer_type& buffer, const header_type& header)
+    {
+        const size_t start = buffer.size();
+
+        uint8_t header_bytes[header_type::SIZE];
+        header.encode(header_bytes);
+        buffer.write(reinterpret_cast<const typename buffer_type::char_type*>(header_bytes), header_type::SIZE);
+
+        return start;
+    }
+
+    template <typename buffer_type>
+    static void endFrame(buffer_type& buffer, size_t start)
+    {
+        if (header_type::HAS_LENGTH)
+        {
+            header_type header;
+            uint8_t header_bytes[header_type::SIZE];
+            memcpy(header_bytes, buffer.data() + start, header_type::SIZE);
+            header.decode(header_bytes);
+            header.setPayloadLength(buffer.size() - start - header_type::SIZE);
+            header.encode(header_bytes);
+            memcpy(buffer.data() + start, header_bytes, header_type::SIZE);
+        }
+
+        // The checksum covers everything after the sync bytes
+        checksum_type checksum;
+        checksum_policy p(checksum);
+        p.update(buffer.data() + start + header_type::SYNC_SIZE, buffer.size() - start - header_type::SYNC_SIZE);
+
+        // Assume little endian encoding
+        buffer.write(reinterpret_cast<const typename buffer_type::char_type*>(&checksum), sizeof(checksum));
+    }
+
+    template<int T, typename buffer_type>
+    void serializeMessage(buffer_type& buffer, typename serialization_policy::template data<T>::type& data, std::false_type)
+    {
+        serializeFrame<T>(buffer, data);
+    }
+
+    template<int T, typename buffer_type>
+    void serializeMessage(buffer_type& buffer, typename serialization_policy::template data<T>::type& data, std::true_type)
+    {
+        using write_policy = typename serialization_policy::template serialization<buffer_type>::write_policy;
+
+        auto& sender = deltaState<T>().sender;
+        const size_t start = beginFrame(buffer, messageHeader<T>());
+
+        const bool keyframe = sender.next(DeltaMode<T>::keyframe_interval);
+        const uint8_t prefix[delta_format::PREFIX_SIZE] = { sender.sequence(), keyframe ? delta_format::KEYFRAME : delta_format::DELTA };
+        buffer.write(reinterpret_cast<const typename buffer_type::char_type*>(prefix), delta_format::PREFIX_SIZE);
+
+        if (keyframe)
+        {
+            serializer<write_policy> s(buffer);
+            s(data);
+        }
+        else
+        {
+            sender.writeDelta(buffer, data);
+        }
+
+        sender.remember(data);
+        endFrame(buffer, start);
+    }
+
+    // Replaces the frame at the end of buffer with a COMPRESSED control frame
+    // holding it, if that is smaller
+    template <typename buffer_type>
+    static void compressFrame(buffer_type& buffer, size_t start)
+    {
+        static constexpr size_t overhead = header_type::SIZE + 1 + sizeof(checksum_type);
+
+        auto frame = reinterpret_cast<const uint8_t*>(buffer.data() + start);
+        const size_t bytes = buffer.size() - start;
+        if (bytes <= overhead + 1)
+            return;
+
+        uint8_t packed[COMPRESSION_THRESHOLD != 0 ? MAX_FRAME_SIZE : 1];
+        const size_t packed_size = lz_codec<>::compress(frame, bytes, packed, bytes - overhead - 1);
+        if (packed_size == 0)
+            return;
+
+        const uint8_t type = control_frame::COMPRESSED;
+
+        buffer.truncate(start);
+        beginFrame(buffer, header_type(control_frame::ID));
+        buffer.write(reinterpret_cast<const typename buffer_type::char_type*>(&type), 1);
+        buffer.write(reinterpret_cast<const typename buffer_type::char_type*>(packed), packed_size);
+        endFrame(buffer, start);
+    }
+
+    template <int N>
+    DeltaState<N>& deltaState()
+    {
+        return _features;
+    }
+
+    void parse(const uint8_t* data, size_t len)
+    {
+        const uint8_t* const begin = data;
+        const uint8_t* const end = data + len;
+
+        // SYNC_1 of the frame being parsed, if it is in this chunk
+        const uint8_t* candidate = nullptr;
+
+        while (data != end)
+        {
+            switch (_parse_state)
+            {
+                case WAIT_FOR_SYNC_1:
+                {
+                    // memchr is vectorised by the C library
+                    auto sync = static_cast<const uint8_t*>(memchr(data, _rx_header.SYNC_1, end - data));
+                    if (sync == nullptr)
+                    {
+                        statsPolicy().add(BYTES_SKIPPED, end - data);
+                        return;
+                    }
+
+                    statsPolicy().add(BYTES_SKIPPED, sync - data);
+                    candidate = sync;
+                    data = sync + 1;
+                    _parse_state = WAIT_FOR_SYNC_2;
+                }
+                break;
+                case WAIT_FOR_DATA:
+                {
+                    size_t count = _payload_size - _input_stream.size();
+                    if (count > size_t(end - data))
+                        count = end - data;
+
+                    _input_stream.receive(data, count);
+                    data += count;
+
+                    if (size_t(_input_stream.size()) == _payload_size)
+                        payloadReceived();
+                }
+                break;
+                case WAIT_FOR_DATA_IN_PLACE:
+                {
+                    size_t count = _payload_size - _received;
+                    if (count > size_t(end - data))
+                        count = end - data;
+
+                    memcpy(&_parse_buffer[_received], data, count);
+                    _received += count;
+                    data += count;
+
+                    if (_received == _payload_size)
+                        payloadReceived();
+                }
+                break;
+                case SKIP_FRAME:
+                {
+                    size_t count = _payload_size - _received;
+                    if (count > size_t(end - data))
+                        count = end - data;
+
+                    _received += count;
+                    data += count;
+
+                    if (_received == _payload_size)
+                        _parse_state = WAIT_FOR_SYNC_1;
+                }
+                break;
+                default:
+                    processChar(*data++);
+                break;
+            }
+
+            if (_rejected_bytes != 0)
+            {
+                data = resync(begin, data, candidate);
+                candidate = nullptr;
+            }
+        }
+    }
+
+    // Drops the frame being parsed after consuming the given number of its
+    // bytes. Its SYNC_1 may have been a payload byte hiding the real start of
+    // the next frame, so parsing resumes from the byte after it rather than
+    // after the bytes already consumed.
+    void rejectFrame(size_t consumed)
+    {
+        _rejected_bytes = consumed;
+        _parse_state = WAIT_FOR_SYNC_1;
+    }
+
+    // Returns where to carry on parsing the chunk [begin, data) after a
+    // rejected frame whose SYNC_1 was at candidate, or in an earlier chunk
+    const uint8_t* resync(const uint8_t* begin, const uint8_t* data, const uint8_t* candidate)
+    {
+        const size_t consumed = _rejected_bytes;
+        _rejected_bytes = 0;
+
+        if (candidate != nullptr)
+            return candidate + 1;
+
+        // The bytes from earlier chunks are still in the header, payload and
+        // checksum buffers. Replay them from the next SYNC_1 on, then this
+        // whole chunk.
+        const size_t current = data - begin;
+        const size_t earlier = consumed > current ? consumed - current : 0;
+        const size_t from = earlier > RESYNC_LOOKBACK + 1 ? earlier - RESYNC_LOOKBACK : 1;
+
+        if (from < earlier)
+        {
+            const size_t bytes = earlier - from;
+            copyFrameBytes(_replay, from, earlier);
+
+            auto sync = static_cast<const uint8_t*>(memchr(_replay, _rx_header.SYNC_1, bytes));
+            if (sync != nullptr)
+                parse(sync, _replay + bytes - sync);
+        }
+
+        return begin;
+    }
+
+    // Copies bytes [from, to) of the frame parsed so far as they appeared on the wire
+    void copyFrameBytes(uint8_t* out, size_t from, size_t to) const
+    {
+        const uint8_t* payload = nullptr;
+        if (to > header_type::SIZE)
+        {
+            payload = lookupOperations(_rx_header.id).in_place
+                ? _parse_buffer
+                : reinterpret_cast<const uint8_t*>(_input_stream.data);
+        }
+
+        const uint8_t* segments[] = { _rx_header_bytes, payload, reinterpret_cast<const uint8_t*>(&_rx_checksum) };
+        const size_t sizes[] = { header_type::SIZE, _payload_size, sizeof(checksum_type) };
+
+        size_t offset = 0;
+        for (int i = 0; i < 3 && from < to; ++i)
+        {
+            if (from < offset + sizes[i])
+            {
+                const size_t bytes = (to < offset + sizes[i] ? to : offset + sizes[i]) - from;
+                memcpy(out, segments[i] + (from - offset), bytes);
+                out += bytes;
+                from += bytes;
+            }
+
+            offset += sizes[i];
+        }
+    }
+
+    // Runs once per parsed chunk
+    void parseFinished()
+    {
+        if (_ack_pending)
+            sendAck();
+
+        endBatch(_message_handlers, 0);
+    }
+
+    // One acknowledgement covers every reliable frame in the chunk
+    void sendAck()
+    {
+        uint8_t ack[reliable_format::ackSize(reliable_window::value)];
+        const size_t bytes = reliableRx().writeAck(ack);
+        _ack_pending = false;
+
+        if (bytes == 0)
+            return;
+
+        MutexLocker<mutex> locker(_send_mutex);
+        bufferControlFrame(ack, 1, reinterpret_cast<const char_type*>(ack + 1), bytes - 1);
+        writeBuffer();
+        flushStream();
+    }
+
+    // Lets handlers that conflate messages run once per parsed chunk
+    template <typename handler>
+    static auto endBatch(handler& h, int) -> decltype(h.dispatchPending(), void())
+    {
+        h.dispatchPending();
+    }
+
+    template <typename handler>
+    static void endBatch(handler&, long) {}
+
+    template <typename stream>
+    static auto readSome(stream& s, uint8_t* buf, size_t n, int) -> decltype(s.readsome(nullptr, 0), size_t())
+    {
+        return s.readsome(reinterpret_cast<typename stream::char_type*>(buf), n);
+    }
+
+    template <typename stream>
+    static size_t readSome(stream&, uint8_t*, size_t, long)
+    {
+        // Stream has no non-blocking bulk read
+        return 0;
+    }
+
+    // Size of the frame whose header is in _rx_header, 0 if unknown
+    size_t datagramFrameSize() const
+    {
+        if (header_type::HAS_LENGTH)
+            return header_type::SIZE + _rx_header.payloadLength() + sizeof(checksum_type);
+
+        const int id = _rx_header.id;
+        if (!serialization_policy::valid(id) || !operation_table::contains(id))
+            return 0;
+
+        return header_type::SIZE + operation_table::lookup(id).size() + sizeof(checksum_type);
+    }
+
+    void headerReceived()
+    {
+        _rx_header.decode(_rx_header_bytes);
+
+        const int id = _rx_header.id;
+        const bool known = serialization_policy::valid(id) && operation_table::contains(id);
+
+        if (header_type::HAS_LENGTH)
+        {
+            // The length lets us step over anything we cannot decode. A
+            // length we cannot take, or one beyond any frame we know of, is
+            // more likely a false sync; skipping it could swallow real frames.
+            if (!known && id != control_frame::ID)
+            {
+                statsPolicy().add(UNKNOWN_IDS);
+                if (header_type::SIZE + _rx_header.payloadLength() + sizeof(checksum_type) > MAX_RX_FRAME_SIZE)
+                    rejectFrame(header_type::SIZE);
+                else
+                    skipFrame(_rx_header.payloadLength() + sizeof(checksum_type));
+            }
+            else if (!beginPayload(lookupOperations(id), _rx_header.payloadLength()))
+            {
+                rejectFrame(header_type::SIZE);
+            }
+        }
+        else if (!known)
+        {
+            statsPolicy().add(UNKNOWN_IDS);
+            rejectFrame(header_type::SIZE);
+        }
+        else
+        {
+            const message_operations& operations = operation_table::lookup(id);
+            beginPayload(operations, operations.size());
+        }
+    }
+
+    bool beginPayload(const message_operations& operations, size_t size)
+    {
+        _payload_size = size;
+        _received = 0;
+
+        if (operations.in_place)
+        {
+            if (size != operations.size())
+            {
+                statsPolicy().add(OVERSIZE_DROPS);
+                return false;
+            }
+
+            _parse_state = WAIT_FOR_DATA_IN_PLACE;
+        }
+        else
+        {
+            if (size > operations.max_size)
+            {
+                statsPolicy().add(OVERSIZE_DROPS);
+                return false;
+            }
+
+            _deserializer.reset();
+            _input_stream.clear();
+            _parse_state = WAIT_FOR_DATA;
+        }
+
+        if (size == 0)
+            payloadReceived();
+
+        return true;
+    }
+
+    void skipFrame(size_t bytes)
+    {
+        _payload_size = bytes;
+        _received = 0;
+        _parse_state = bytes > 0 ? SKIP_FRAME : WAIT_FOR_SYNC_1;
+    }
+
+    void payloadReceived()
+    {
+        const message_operations& operations = lookupOperations(_rx_header.id);
+
+        // Staged payloads must decode without running short and consume every byte
+        if (operations.in_place
+            || (operations.deserialize(*this) && _input_stream.remaining() == 0))
+        {
+            _received = 0;
+            _parse_state = WAIT_FOR_CRC;
+        }
+        else
+        {
+            statsPolicy().add(DECODE_FAILURES);
+            rejectFrame(header_type::SIZE + _payload_size);
+        }
+    }
+
+    void frameReceived()
+    {
+        const message_operations& operations = lookupOperations(_rx_header.id);
+
+        // Checksum the header and payload as they appeared on the wire
+        const uint8_t* payload = operations.in_place ? _parse_buffer : reinterpret_cast<const uint8_t*>(_input_stream.data);
+
+        checksum_type checksum;
+        checksum_policy p(checksum);
+        p.update(&_rx_header_bytes[header_type::SYNC_SIZE], header_type::SIZE - header_type::SYNC_SIZE);
+        p.update(payload, _payload_size);
+
+        if (checksum != _rx_checksum)
+        {
+            statsPolicy().add(CHECKSUM_FAILURES);
+            rejectFrame(header_type::SIZE + _payload_size + sizeof(checksum_type));
+            return;
+        }
+
+        statsPolicy().frameReceived(_rx_header.id);
+        traceRx().record(_rx_header);
+
+        const auto start = stats_policy::now();
+        operations.callback(*this);
+        statsPolicy().handlerFinished(start);
+
+        _parse_state = WAIT_FOR_SYNC_1;
+    }
+
+    void controlReceived()
+    {
+        auto payload = reinterpret_cast<const uint8_t*>(_input_stream.data);
+        if (_payload_size == 0)
+            return;
+
+        switch (payload[0])
+        {
+            case control_frame::FRAGMENT:
+            {
+                size_t frame_size;
+                const uint8_t* frame = reassembly().add(payload, _payload_size, frame_size);
+                if (frame != nullptr)
+                {
+                    // Parse the rebuilt frame from scratch, it carries its own checksum
+                    _parse_state = WAIT_FOR_SYNC_1;
+                    parse(frame, frame_size);
+                }
+            }
+            break;
+            case control_frame::RELIABLE:
+            {
+                if (!reliableRx().add(payload + 1, _payload_size - 1))
+                    statsPolicy().add(DUPLICATES);
+
+                // Acknowledge duplicates too, the previous ACK may have been lost
+                _ack_pending = true;
+
+                reliableRx().deliver([this](const uint8_t* frame, size_t frame_size)
+                {
+                    _parse_state = WAIT_FOR_SYNC_1;
+                    parse(frame, frame_size);
+                });
+            }
+            break;
+            case control_frame::COMPRESSED:
+            {
+                // Decompressed frames go through the parser like any other,
+                // their own checksum covers them end to end. Senders never
+                // compress twice, so nested frames are rejected rather than
+                // overwriting the buffer being parsed.
+                const size_t frame_size = COMPRESSION_THRESHOLD != 0 && !_decompressing
+                    ? lz_codec<>::decompress(payload + 1, _payload_size - 1, _decompressed, sizeof(_decompressed))
+                    : 0;
+
+                if (frame_size != 0)
+                {
+                    _decompressing = true;
+                    _parse_state = WAIT_FOR_SYNC_1;
+                    parse(_decompressed, frame_size);
+                    _decompressing = false;
+                }
+                else
+                {
+                    statsPolicy().add(DECODE_FAILURES);
+                }
+            }
+            break;
+            case control_frame::ACK:
+            {
+                MutexLocker<mutex> locker(_send_mutex);
+
+                // Holes reported by the peer are resent straight away
+                if (reliableTx().acknowledge(payload + 1, _payload_size - 1))
+                    resendDue();
+
+                windowOpen().notify_all();
+            }
+            break;
+            default:
+            break;
+        }
+    }
+
+    void processChar(int c)
+    {
+        switch (_parse_state)
+        {
+            case WAIT_FOR_SYNC_1:
+                if (c == _rx_header.SYNC_1)
+                    _parse_state = WAIT_FOR_SYNC_2;
+                else
+                    statsPolicy().add(BYTES_SKIPPED);
+            break;
+            case WAIT_FOR_SYNC_2:
+                if (c == _rx_header.SYNC_2)
+                {
+                    _rx_header_bytes[0] = _rx_header.SYNC_1;
+                    _rx_header_bytes[1] = _rx_header.SYNC_2;
+                    _received = header_type::SYNC_SIZE;
+                    _parse_state = WAIT_FOR_HEADER;
+                }
+                else
+                {
+                    statsPolicy().add(SYNC_LOSSES);
+                    rejectFrame(header_type::SYNC_SIZE);
+                }
+            break;
+            case WAIT_FOR_HEADER:
+            {
+                _rx_header_bytes[_received++] = c;
+                if (_received == header_type::SIZE)
+                    headerReceived();
+            }
+            break;
+            case WAIT_FOR_DATA:
+            {
+                _input_stream.receive(c);
+                if (size_t(_input_stream.size()) == _payload_size)
+                    payloadReceived();
+            }
+            break;
+            case WAIT_FOR_DATA_IN_PLACE:
+            {
+                _parse_buffer[_received++] = c;
+                if (_received == _payload_size)
+                    payloadReceived();
+            }
+            break;
+            case WAIT_FOR_CRC:
+            {
+                // Assume little endian encoding
+                reinterpret_cast<uint8_t*>(&_rx_checksum)[_received++] = c;
+                if (_received == sizeof(checksum_type))
+                    frameReceived();
+            }
+            break;
+            case SKIP_FRAME:
+            {
+                if (++_received == _payload_size)
+                    _parse_state = WAIT_FOR_SYNC_1;
             }
             break;
         }
@@ -1,17 +1,26 @@
 #ifndef DATATRANSFER_PACKET_TYPES_H
 #define DATATRANSFER_PACKET_TYPES_H
 
+#include <cstddef>
 #include <stdint.h>
 
 namespace datatransfer {
 
+// Wire layout: SYNC_1 SYNC_2 id. The payload size is implied by the id.
 struct packet_header
 {
+    // Leading bytes not covered by the checksum
+    static constexpr size_t SYNC_SIZE = 2;
+    static constexpr size_t SIZE = 3;
+    static constexpr bool HAS_LENGTH = false;
+    static constexpr bool HAS_TRACE = false;
+    static constexpr size_t MAX_PAYLOAD_LENGTH = SIZE_MAX;
+
     uint8_t SYNC_1;
     uint8_t SYNC_2;
     uint8_t id;
 
-    packet_header(const uint8_t id)
+    packet_header(const uint8_t id = 0)
         : SYNC_1(0x55)
         , SYNC_2(0xAA)
         , id(id)
@@ -24,6 +33,109 @@ struct packet_header
         p % SYNC_2;
         p % id;
     }
+
+    size_t payloadLength() const { return 0; }
+    void setPayloadLength(size_t) {}
+
+    void encode(uint8_t* buf) const
+    {
+        buf[0] = SYNC_1;
+        buf[1] = SYNC_2;
+        buf[2] = id;
+    }
+
+    void decode(const uint8_t* buf)
+    {
+        id = buf[2];
+    }
+};
+
+// Wire layout: SYNC_1 SYNC_2 id length_lo length_hi. The explicit payload
+// length allows variable sized payloads and lets the parser skip frames it
+// cannot decode without losing synchronisation.
+struct length_packet_header : packet_header
+{
+    static constexpr size_t SIZE = 5;
+    static constexpr bool HAS_LENGTH = true;
+    static constexpr size_t MAX_PAYLOAD_LENGTH = UINT16_MAX;
+
+    uint16_t length;
+
+    length_packet_header(const uint8_t id = 0, const uint16_t length = 0)
+        : packet_header(id)
+        , length(length)
+    {}
+
+    template <typename policy>
+    void method(policy& p)
+    {
+        packet_header::method(p);
+        p % length;
+    }
+
+    size_t payloadLength() const { return length; }
+    void setPayloadLength(size_t bytes) { length = uint16_t(bytes); }
+
+    void encode(uint8_t* buf) const
+    {
+        packet_header::encode(buf);
+        buf[3] = uint8_t(length);
+        buf[4] = uint8_t(length >> 8);
+    }
+
+    void decode(const uint8_t* buf)
+    {
+        packet_header::decode(buf);
+        length = uint16_t(buf[3] | (buf[4] << 8));
+    }
+};
+
+// Wire layout: the base header, then sequence_lo sequence_hi and a four
+// byte little endian timestamp. p2p_connector stamps every message frame
+// with a per message ID sequence number and the send time (trace_clock)
+// and tracks loss, duplication and latency per ID on receive.
+template <typename base_header = packet_header>
+struct traced_header : base_header
+{
+    static constexpr size_t SIZE = base_header::SIZE + 6;
+    static constexpr bool HAS_TRACE = true;
+
+    uint16_t sequence;
+    uint32_t timestamp;
+
+    traced_header(const uint8_t id = 0)
+        : base_header(id)
+        , sequence(0)
+        , timestamp(0)
+    {}
+
+    template <typename policy>
+    void method(policy& p)
+    {
+        base_header::method(p);
+        p % sequence;
+        p % timestamp;
+    }
+
+    void encode(uint8_t* buf) const
+    {
+        base_header::encode(buf);
+        buf += base_header::SIZE;
+        buf[0] = uint8_t(sequence);
+        buf[1] = uint8_t(sequence >> 8);
+        buf[2] = uint8_t(timestamp);
+        buf[3] = uint8_t(timestamp >> 8);
+        buf[4] = uint8_t(timestamp >> 16);
+        buf[5] = uint8_t(timestamp >> 24);
+    }
+
+    void decode(const uint8_t* buf)
+    {
+        base_header::decode(buf);
+        buf += base_header::SIZE;
+        sequence = uint16_t(buf[0] | (buf[1] << 8));
+        timestamp = uint32_t(buf[2]) | (uint32_t(buf[3]) << 8) | (uint32_t(buf[4]) << 16) | (uint32_t(buf[5]) << 24);
+    }
 };
 
 template <typename checksum_type>
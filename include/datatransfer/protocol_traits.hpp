@@ -0,0 +1,176 @@
+#ifndef DATATRANSFER_PROTOCOL_TRAITS_HPP
+#define DATATRANSFER_PROTOCOL_TRAITS_HPP
+
+#include <type_traits>
+#include "packet_types.h"
+
+namespace datatransfer {
+
+template <typename>
+struct void_type { using type = void; };
+
+// serialization_policy::header_type selects the frame header, packet_header
+// when not given. traced_header<...> adds per message sequence numbers and
+// send timestamps, see p2p_connector::trace().
+template <typename serialization_policy, typename = void>
+struct header_type_of
+{
+    using type = packet_header;
+};
+
+template <typename serialization_policy>
+struct header_type_of<serialization_policy, typename void_type<typename serialization_policy::header_type>::type>
+{
+    using type = typename serialization_policy::header_type;
+};
+
+// data<N>::keyframe_interval > 0 sends message N in delta mode with a full
+// keyframe every keyframe_interval frames
+template <typename message_data, typename = void>
+struct keyframe_interval_of : std::integral_constant<int, 0> {};
+
+template <typename message_data>
+struct keyframe_interval_of<message_data, typename void_type<decltype(message_data::keyframe_interval)>::type>
+    : std::integral_constant<int, message_data::keyframe_interval>
+{};
+
+// data<N>::conflate = true keeps only the newest value of message N when
+// the consumer or the link falls behind
+template <typename message_data, typename = void>
+struct conflate_of : std::false_type {};
+
+template <typename message_data>
+struct conflate_of<message_data, typename void_type<decltype(message_data::conflate)>::type>
+    : std::integral_constant<bool, message_data::conflate>
+{};
+
+// serialization_policy::PRIORITY_LEVELS sets the number of send priority
+// classes, data<N>::priority picks one (higher is more urgent, default 0)
+template <typename serialization_policy, typename = void>
+struct priority_levels_of : std::integral_constant<int, 1> {};
+
+template <typename serialization_policy>
+struct priority_levels_of<serialization_policy, typename void_type<decltype(serialization_policy::PRIORITY_LEVELS)>::type>
+    : std::integral_constant<int, serialization_policy::PRIORITY_LEVELS>
+{};
+
+template <typename message_data, typename = void>
+struct priority_of : std::integral_constant<int, 0> {};
+
+template <typename message_data>
+struct priority_of<message_data, typename void_type<decltype(message_data::priority)>::type>
+    : std::integral_constant<int, message_data::priority>
+{};
+
+// serialization_policy::FRAGMENT_SIZE > 0 splits queued frames larger than
+// FRAGMENT_SIZE bytes into fragments so more urgent frames can overtake them
+template <typename serialization_policy, typename = void>
+struct fragment_size_of : std::integral_constant<size_t, 0> {};
+
+template <typename serialization_policy>
+struct fragment_size_of<serialization_policy, typename void_type<decltype(serialization_policy::FRAGMENT_SIZE)>::type>
+    : std::integral_constant<size_t, serialization_policy::FRAGMENT_SIZE>
+{};
+
+// data<N>::reliable = true sends message N through the reliable delivery
+// window, sized by serialization_policy::RELIABLE_WINDOW (0 disables it).
+// Unacknowledged frames are resent after RETRANSMIT_TIMEOUT_MS.
+template <typename message_data, typename = void>
+struct reliable_of : std::false_type {};
+
+template <typename message_data>
+struct reliable_of<message_data, typename void_type<decltype(message_data::reliable)>::type>
+    : std::integral_constant<bool, message_data::reliable>
+{};
+
+template <typename serialization_policy, typename = void>
+struct reliable_window_of : std::integral_constant<size_t, 0> {};
+
+template <typename serialization_policy>
+struct reliable_window_of<serialization_policy, typename void_type<decltype(serialization_policy::RELIABLE_WINDOW)>::type>
+    : std::integral_constant<size_t, serialization_policy::RELIABLE_WINDOW>
+{};
+
+template <typename serialization_policy, typename = void>
+struct retransmit_timeout_of : std::integral_constant<int, 50> {};
+
+template <typename serialization_policy>
+struct retransmit_timeout_of<serialization_policy, typename void_type<decltype(serialization_policy::RETRANSMIT_TIMEOUT_MS)>::type>
+    : std::integral_constant<int, serialization_policy::RETRANSMIT_TIMEOUT_MS>
+{};
+
+// serialization_policy::SEND_TIMEOUT_MS bounds how long sending a reliable
+// message waits for room in the send window before giving up
+template <typename serialization_policy, typename = void>
+struct send_timeout_of : std::integral_constant<int, 1000> {};
+
+template <typename serialization_policy>
+struct send_timeout_of<serialization_policy, typename void_type<decltype(serialization_policy::SEND_TIMEOUT_MS)>::type>
+    : std::integral_constant<int, serialization_policy::SEND_TIMEOUT_MS>
+{};
+
+// serialization_policy::RESYNC_LOOKBACK bounds how many bytes of an
+// unfinished frame are kept to rescan for a sync if the frame turns out to
+// be false, the largest receivable frame by default
+template <typename serialization_policy, size_t default_size, typename = void>
+struct resync_lookback_of : std::integral_constant<size_t, default_size> {};
+
+template <typename serialization_policy, size_t default_size>
+struct resync_lookback_of<serialization_policy, default_size, typename void_type<decltype(serialization_policy::RESYNC_LOOKBACK)>::type>
+    : std::integral_constant<size_t, serialization_policy::RESYNC_LOOKBACK>
+{};
+
+// serialization_policy::COMPRESSION_THRESHOLD > 0 compresses every frame of
+// at least that many bytes, as long as it gets smaller
+template <typename serialization_policy, typename = void>
+struct compression_threshold_of : std::integral_constant<size_t, 0> {};
+
+template <typename serialization_policy>
+struct compression_threshold_of<serialization_policy, typename void_type<decltype(serialization_policy::COMPRESSION_THRESHOLD)>::type>
+    : std::integral_constant<size_t, serialization_policy::COMPRESSION_THRESHOLD>
+{};
+
+// size_policy::FIXED_WIDTH = false marks encodings whose integer sizes
+// depend on their values, such as varint_serialization
+template <typename size_policy, typename = void>
+struct fixed_width_of : std::true_type {};
+
+template <typename size_policy>
+struct fixed_width_of<size_policy, typename void_type<decltype(size_policy::FIXED_WIDTH)>::type>
+    : std::integral_constant<bool, size_policy::FIXED_WIDTH>
+{};
+
+// serialization_policy::MAX_CONNECTOR_SIZE fails the build if a connector
+// for the protocol takes more memory, for targets with a fixed RAM budget
+template <typename serialization_policy, typename = void>
+struct max_connector_size_of : std::integral_constant<size_t, SIZE_MAX> {};
+
+template <typename serialization_policy>
+struct max_connector_size_of<serialization_policy, typename void_type<decltype(serialization_policy::MAX_CONNECTOR_SIZE)>::type>
+    : std::integral_constant<size_t, serialization_policy::MAX_CONNECTOR_SIZE>
+{};
+
+// input_output_stream::MAX_WRITE_SIZE is the most a single write() may carry,
+// e.g. one datagram. The connector's TX buffer must fit in it.
+template <typename input_output_stream, typename = void>
+struct max_write_size_of : std::integral_constant<size_t, SIZE_MAX> {};
+
+template <typename input_output_stream>
+struct max_write_size_of<input_output_stream, typename void_type<decltype(input_output_stream::MAX_WRITE_SIZE)>::type>
+    : std::integral_constant<size_t, input_output_stream::MAX_WRITE_SIZE>
+{};
+
+// input_output_stream::FLUSH_ON_SEND = false stops p2p_connector::send()
+// from flushing the stream after every message, so a stream that queues
+// writes can hand them over together; p2p_connector::flush() flushes.
+template <typename input_output_stream, typename = void>
+struct flush_on_send_of : std::true_type {};
+
+template <typename input_output_stream>
+struct flush_on_send_of<input_output_stream, typename void_type<decltype(input_output_stream::FLUSH_ON_SEND)>::type>
+    : std::integral_constant<bool, input_output_stream::FLUSH_ON_SEND>
+{};
+
+}
+
+#endif // DATATRANSFER_PROTOCOL_TRAITS_HPP
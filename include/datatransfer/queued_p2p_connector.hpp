@@ -0,0 +1,365 @@
+#ifndef DATATRANSFER_QUEUED_P2P_CONNECTOR_HPP
+#define DATATRANSFER_QUEUED_P2P_CONNECTOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "p2p_connector.hpp"
+#include "mpmc_queue.hpp"
+#include "seqlock.hpp"
+
+namespace datatransfer {
+
+// What send<T>() does when the frame queue is full
+enum class backpressure
+{
+    BLOCK,
+    DROP_NEWEST,
+    DROP_OLDEST
+};
+
+// p2p_connector whose senders never touch the stream: send<T>() serializes
+// the frame into a lock-free queue and a single writer, either the thread
+// started with startWriter() or whoever calls flushPending(), drains it to
+// the stream with coalesced writes.
+//
+// Message types whose data<N> sets conflate = true skip the queue: send<T>()
+// overwrites a pending slot and only the newest value is written on the
+// next flush, after the queued frames.
+//
+// With PRIORITY_LEVELS in the serialization policy each level gets its own
+// queue and the writer always serves the most urgent one first. With
+// FRAGMENT_SIZE as well, larger frames go out in fragments and the TX
+// buffer is handed to the stream after each one, so an urgent frame waits
+// for at most one fragment, not a whole bulk frame.
+template<typename mutex,
+         typename input_output_stream,
+         typename serialization_policy,
+         typename callback_handler_type,
+         size_t queue_size = 256,
+         backpressure overflow = backpressure::BLOCK,
+         size_t tx_buffer_size = 1024,
+         typename stats_policy = no_stats>
+class queued_p2p_connector
+    : public p2p_connector<mutex, input_output_stream, serialization_policy, callback_handler_type, tx_buffer_size, stats_policy>
+{
+    using base = p2p_connector<mutex, input_output_stream, serialization_policy, callback_handler_type, tx_buffer_size, stats_policy>;
+    using frame_type = frame_buffer<typename input_output_stream::char_type, base::MAX_FRAME_SIZE>;
+    using frame_queue = mpmc_queue<frame_type, queue_size>;
+    using message_ids = typename make_message_sequence<1, serialization_policy::NUMBER_OF_MESSAGES>::type;
+
+    template <int N>
+    using conflated = conflate_of<typename serialization_policy::template data<N>>;
+
+    template <int N, bool = conflated<N>::value>
+    struct PendingSlot {};
+
+    template <int N>
+    struct PendingSlot<N, true>
+    {
+        PendingSlot()
+            : pending(false)
+        {}
+
+        seqlock<typename serialization_policy::template data<N>::type> value;
+        std::atomic<bool> pending;
+    };
+
+    template <typename sequence>
+    struct PendingSlots;
+
+    template <int ...N>
+    struct PendingSlots<message_sequence<N...>> : PendingSlot<N>...
+    {
+        template <int id>
+        PendingSlot<id>& get() { return *this; }
+    };
+
+    struct flush_operations
+    {
+        // Returns true if a frame was buffered
+        bool (*flush)(queued_p2p_connector&);
+    };
+
+    template <int N>
+    struct FlushOperations
+    {
+        static bool flush(queued_p2p_connector& connector)
+        {
+            auto& slot = connector._pending_slots.template get<N>();
+            if (!slot.pending.exchange(false, std::memory_order_acquire))
+                return false;
+
+            typename serialization_policy::template data<N>::type data;
+            slot.value.load(data);
+            connector.template bufferFrame<N>(data);
+            return true;
+        }
+
+        static constexpr flush_operations make()
+        {
+            return make(std::integral_constant<bool, conflated<N>::value>());
+        }
+
+        static constexpr flush_operations make(std::true_type) { return flush_operations{ &flush }; }
+        static constexpr flush_operations make(std::false_type) { return flush_operations{ nullptr }; }
+    };
+
+    using flush_table = message_table<flush_operations, FlushOperations, message_ids>;
+
+    // A frame being sent in fragments
+    struct partial_frame
+    {
+        partial_frame()
+            : offset(0)
+            , index(0)
+        {}
+
+        bool active() const { return offset < frame.size(); }
+
+        frame_type frame;
+        size_t offset;
+        uint8_t index;
+    };
+
+public:
+    queued_p2p_connector(input_output_stream& stream)
+        : base(stream)
+        , _dropped(0)
+        , _fragmenting(0)
+        , _conflated_pending(false)
+        , _running(false)
+    {}
+
+    ~queued_p2p_connector()
+    {
+        stopWriter();
+    }
+
+    // Returns false if the frame was dropped
+    template<int T>
+    bool send(typename serialization_policy::template data<T>::type& data)
+    {
+        static_assert(serialization_policy::valid(T), "T is not a valid message type");
+        static_assert(!reliable_of<typename serialization_policy::template data<T>>::value,
+                      "Reliable messages are sent through p2p_connector");
+
+        const auto start = stats_policy::now();
+        const bool queued = enqueue<T>(data, std::integral_constant<bool, conflated<T>::value>());
+        this->statsPolicy().sendFinished(start);
+
+        return queued;
+    }
+
+    // Writes out at most one queue's worth of frames per priority level,
+    // returns the number of frames and fragments written
+    size_t flushPending()
+    {
+        MutexLocker<mutex> locker(this->_send_mutex);
+
+        size_t frames = 0;
+        while (frames < queue_size * base::PRIORITY_LEVELS && writeNext())
+        {
+            ++frames;
+
+            // Hand each fragment's worth to the stream, so a frame queued
+            // meanwhile waits behind one fragment, not a full TX buffer
+            if (base::FRAGMENT_SIZE != 0 && this->_tx_buffer.size() >= base::FRAGMENT_SIZE)
+                this->writeBuffer();
+        }
+
+        if (_conflated_pending.exchange(false, std::memory_order_acquire))
+        {
+            for (int id = 1; id <= serialization_policy::NUMBER_OF_MESSAGES; ++id)
+            {
+                const flush_operations& operations = flush_table::lookup(id);
+                if (operations.flush != nullptr && operations.flush(*this))
+                    ++frames;
+            }
+        }
+
+        if (frames > 0)
+        {
+            this->writeBuffer();
+            this->flushStream();
+        }
+
+        return frames;
+    }
+
+    void startWriter()
+    {
+        if (!_running.exchange(true))
+            _writer = std::thread([this] { writerLoop(); });
+    }
+
+    void stopWriter()
+    {
+        if (_running.exchange(false))
+            _writer.join();
+    }
+
+    // Frames queued or partly written as fragments
+    size_t pending() const
+    {
+        size_t frames = _fragmenting.load(std::memory_order_relaxed);
+        for (const auto& queue : _queues)
+            frames += queue.size();
+
+        return frames;
+    }
+    size_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    template<int T>
+    bool enqueue(typename serialization_policy::template data<T>::type& data, std::false_type)
+    {
+        static constexpr int level = priority_of<typename serialization_policy::template data<T>>::value;
+        static_assert(level >= 0 && level < base::PRIORITY_LEVELS, "Message priority exceeds PRIORITY_LEVELS");
+
+        auto serialize = [this, &data](frame_type& frame)
+        {
+            frame.clear();
+            this->template serializeMessage<T>(frame, data);
+        };
+
+        return push(_queues[level], serialize, std::integral_constant<bool, base::template DeltaMode<T>::value>());
+    }
+
+    template<int T>
+    bool enqueue(typename serialization_policy::template data<T>::type& data, std::true_type)
+    {
+        auto& slot = _pending_slots.template get<T>();
+        slot.value.store(data);
+        slot.pending.store(true, std::memory_order_release);
+        _conflated_pending.store(true, std::memory_order_release);
+
+        return true;
+    }
+
+    template <typename writer>
+    bool push(frame_queue& queue, writer& serialize, std::false_type)
+    {
+        while (!queue.try_push(serialize))
+        {
+            switch (overflow)
+            {
+                case backpressure::BLOCK:
+                    std::this_thread::yield();
+                break;
+                case backpressure::DROP_NEWEST:
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                case backpressure::DROP_OLDEST:
+                    if (queue.try_pop([](frame_type&) {}))
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    // Delta frames depend on the previous frame of their type, so encoding
+    // and queueing them must happen in one order. A dropped delta frame makes
+    // the receiver wait for the next keyframe.
+    template <typename writer>
+    bool push(frame_queue& queue, writer& serialize, std::true_type)
+    {
+        MutexLocker<mutex> locker(_delta_mutex);
+
+        return push(queue, serialize, std::false_type());
+    }
+
+    // The following require _send_mutex to be held
+
+    // Writes the next fragment or frame of the most urgent level with work
+    bool writeNext()
+    {
+        for (int level = base::PRIORITY_LEVELS - 1; level >= 0; --level)
+        {
+            if (base::FRAGMENT_SIZE != 0 && _partial[level].active())
+            {
+                writeFragment(level);
+                return true;
+            }
+
+            if (_queues[level].try_pop([this, level](frame_type& frame) { writeFrame(level, frame); }))
+                return true;
+        }
+
+        return false;
+    }
+
+    void writeFrame(int level, const frame_type& frame)
+    {
+        if (base::FRAGMENT_SIZE == 0 || frame.size() <= base::FRAGMENT_SIZE)
+        {
+            this->bufferBytes(frame.data(), frame.size());
+            return;
+        }
+
+        // Keep a copy so more urgent frames can go out between its fragments
+        partial_frame& p = _partial[level];
+        p.frame.clear();
+        p.frame.write(frame.data(), frame.size());
+        p.offset = 0;
+        p.index = 0;
+        _fragmenting.fetch_add(1, std::memory_order_relaxed);
+
+        writeFragment(level);
+    }
+
+    void writeFragment(int level)
+    {
+        partial_frame& p = _partial[level];
+
+        size_t bytes = p.frame.size() - p.offset;
+        if (bytes > base::FRAGMENT_SIZE)
+            bytes = base::FRAGMENT_SIZE;
+
+        uint8_t flags = 0;
+        if (p.offset == 0)
+            flags |= fragment_format::FIRST;
+        if (p.offset + bytes == p.frame.size())
+            flags |= fragment_format::LAST;
+
+        const uint8_t prefix[fragment_format::PREFIX_SIZE] = { control_frame::FRAGMENT, uint8_t(level), p.index++, flags };
+        this->bufferControlFrame(prefix, fragment_format::PREFIX_SIZE, p.frame.data() + p.offset, bytes);
+        p.offset += bytes;
+
+        if (flags & fragment_format::LAST)
+            _fragmenting.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void writerLoop()
+    {
+        unsigned idle = 0;
+
+        while (_running.load(std::memory_order_acquire))
+        {
+            if (flushPending() > 0)
+                idle = 0;
+            else if (++idle < 64)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        flushPending();
+    }
+
+    mutex _delta_mutex;
+    frame_queue _queues[base::PRIORITY_LEVELS];
+    partial_frame _partial[base::PRIORITY_LEVELS];
+    std::atomic<size_t> _dropped;
+    std::atomic<size_t> _fragmenting;
+    PendingSlots<message_ids> _pending_slots;
+    std::atomic<bool> _conflated_pending;
+    std::atomic<bool> _running;
+    std::thread _writer;
+};
+
+}
+
+#endif // DATATRANSFER_QUEUED_P2P_CONNECTOR_HPP
@@ -0,0 +1,204 @@
+#ifndef DATATRANSFER_RCU_CALLBACK_HANDLER_HPP
+#define DATATRANSFER_RCU_CALLBACK_HANDLER_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <stdint.h>
+#include <vector>
+
+namespace datatransfer {
+
+// Callback handler with any number of subscribers per message ID. Each ID
+// holds a pointer to an immutable subscriber list; signal<N>() walks the
+// current list without taking a lock, while subscribe and unsubscribe copy
+// the list, publish the copy and free the old one once no signal<N>() can
+// still be reading it (two-phase reader counts, as in sleepable RCU).
+//
+// Subscribing or unsubscribing from inside a handler of the same object
+// deadlocks, since the writer would wait for its own read section.
+template <typename serialization_policy>
+class rcu_callback_handler
+{
+public:
+    template <int N>
+    using function_type = std::function<void(const typename serialization_policy::template data<N>::type&)>;
+
+    using subscription = uint64_t;
+
+    rcu_callback_handler()
+        : _index(0)
+        , _next_subscription(1)
+    {
+        _readers[0].store(0, std::memory_order_relaxed);
+        _readers[1].store(0, std::memory_order_relaxed);
+    }
+
+    ~rcu_callback_handler()
+    {
+        _lists.destroy();
+    }
+
+    template <int N>
+    void signal(const typename serialization_policy::template data<N>::type& t)
+    {
+        const unsigned index = _index.load(std::memory_order_acquire) & 1;
+        _readers[index].fetch_add(1, std::memory_order_seq_cst);
+
+        const subscriber_list<N>* list = slot<N>().load(std::memory_order_seq_cst);
+        if (list != nullptr)
+        {
+            for (const auto& entry : list->entries)
+                entry.function(t);
+        }
+
+        _readers[index].fetch_sub(1, std::memory_order_release);
+    }
+
+    // Adds a subscriber, returns the handle to pass to deregisterHandler()
+    template <int N>
+    subscription registerHandler(function_type<N> func)
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        std::unique_ptr<subscriber_list<N>> list(copyList<N>());
+        const subscription id = _next_subscription++;
+        list->entries.push_back(subscriber<N>{ id, std::move(func) });
+
+        publish<N>(list.release());
+        return id;
+    }
+
+    template <int N>
+    void deregisterHandler(subscription id)
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        std::unique_ptr<subscriber_list<N>> list(copyList<N>());
+        for (auto it = list->entries.begin(); it != list->entries.end(); ++it)
+        {
+            if (it->id == id)
+            {
+                list->entries.erase(it);
+                publish<N>(list.release());
+                return;
+            }
+        }
+    }
+
+    // Removes every subscriber of N
+    template <int N>
+    void deregisterHandler()
+    {
+        std::lock_guard<std::mutex> lock(_writer_mutex);
+
+        publish<N>(nullptr);
+    }
+
+protected:
+    template <int N>
+    struct subscriber
+    {
+        subscription id;
+        function_type<N> function;
+    };
+
+    template <int N>
+    struct subscriber_list
+    {
+        std::vector<subscriber<N>> entries;
+    };
+
+    template <int N, int count>
+    struct ListHelper
+    {
+        ListHelper()
+            : first(nullptr)
+        {}
+
+        void destroy()
+        {
+            delete first.load(std::memory_order_relaxed);
+            second.destroy();
+        }
+
+        std::atomic<subscriber_list<N>*> first;
+        ListHelper<N+1, count-1> second;
+    };
+
+    template <int N>
+    struct ListHelper<N, 0>
+    {
+        void destroy() {}
+    };
+
+    template <int id, int N, int count>
+    struct RetrieveHelper
+    {
+        static constexpr std::atomic<subscriber_list<id>*>& retrieve(ListHelper<N, count>& helper)
+        {
+            return RetrieveHelper<id,N+1,count-1>::retrieve(helper.second);
+        }
+    };
+
+    template <int id, int count>
+    struct RetrieveHelper<id, id, count>
+    {
+        static constexpr std::atomic<subscriber_list<id>*>& retrieve(ListHelper<id, count>& helper)
+        {
+            return helper.first;
+        }
+    };
+
+private:
+    template <int N>
+    std::atomic<subscriber_list<N>*>& slot()
+    {
+        return RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_lists);
+    }
+
+    // The following require _writer_mutex to be held
+
+    template <int N>
+    subscriber_list<N>* copyList()
+    {
+        const subscriber_list<N>* current = slot<N>().load(std::memory_order_relaxed);
+        return current != nullptr ? new subscriber_list<N>(*current) : new subscriber_list<N>();
+    }
+
+    template <int N>
+    void publish(subscriber_list<N>* list)
+    {
+        subscriber_list<N>* old = slot<N>().exchange(list, std::memory_order_seq_cst);
+        if (old != nullptr)
+        {
+            synchronize();
+            delete old;
+        }
+    }
+
+    // Waits until every signal() that might have seen the previous lists has
+    // finished. Flipping twice also catches readers that picked an index
+    // just before the first flip.
+    void synchronize()
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            const unsigned old = _index.fetch_add(1, std::memory_order_seq_cst) & 1;
+            while (_readers[old].load(std::memory_order_seq_cst) != 0)
+                std::this_thread::yield();
+        }
+    }
+
+    ListHelper<1, serialization_policy::NUMBER_OF_MESSAGES> _lists;
+    std::atomic<unsigned> _index;
+    std::atomic<unsigned> _readers[2];
+    std::mutex _writer_mutex;
+    subscription _next_subscription;
+};
+
+}
+
+#endif // DATATRANSFER_RCU_CALLBACK_HANDLER_HPP
@@ -0,0 +1,315 @@
+#ifndef DATATRANSFER_RELIABLE_DELIVERY_HPP
+#define DATATRANSFER_RELIABLE_DELIVERY_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include "fragmentation.hpp"
+
+namespace datatransfer {
+
+// Reliable frames are control frames: RELIABLE, sender epoch, sequence
+// number (both little endian), then the original frame bytes. The receiver
+// answers with ACK, the epoch, next expected sequence number, then a bitmap
+// of the window starting at that sequence number with a bit set for every
+// frame already received. A clear bit below a set one is a selective NACK.
+// The epoch is picked when the sender is created, so a receiver can tell a
+// restarted peer counting from 0 again and start over with it.
+struct reliable_format
+{
+    static constexpr size_t DATA_PREFIX_SIZE = 5;
+    static constexpr size_t ACK_PREFIX_SIZE = 5;
+
+    static constexpr size_t ackSize(size_t window) { return ACK_PREFIX_SIZE + window / 8; }
+
+    static void encodeSequence(uint8_t* buf, uint16_t seq)
+    {
+        buf[0] = uint8_t(seq);
+        buf[1] = uint8_t(seq >> 8);
+    }
+
+    static uint16_t decodeSequence(const uint8_t* buf)
+    {
+        return uint16_t(buf[0] | (buf[1] << 8));
+    }
+};
+
+// Send window: keeps a copy of every unacknowledged frame until the peer
+// acknowledges it, retransmitting on timeout or on a selective NACK
+template <size_t window, size_t frame_size>
+class reliable_sender
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static_assert(window >= 8 && window <= 1024 && (window & (window - 1)) == 0,
+                  "Reliable window must be a power of two between 8 and 1024");
+
+    reliable_sender()
+        : _epoch(newEpoch())
+        , _base(0)
+        , _next(0)
+    {}
+
+    uint16_t epoch() const { return _epoch; }
+
+    bool full() const { return uint16_t(_next - _base) == window; }
+
+    size_t inFlight() const { return uint16_t(_next - _base); }
+
+    // Stores a new frame and returns its sequence number
+    uint16_t push(const uint8_t* frame, size_t bytes, clock::time_point deadline)
+    {
+        const uint16_t seq = _next++;
+
+        slot& s = _slots[seq % window];
+        memcpy(s.data, frame, bytes);
+        s.size = bytes;
+        s.deadline = deadline;
+        s.acked = false;
+        s.nacked = false;
+
+        return seq;
+    }
+
+    // Applies an ACK payload (without the control type byte), returns true
+    // if it reported holes that should be retransmitted right away
+    bool acknowledge(const uint8_t* ack, size_t bytes)
+    {
+        if (bytes < reliable_format::ACK_PREFIX_SIZE - 1 + window / 8)
+            return false;
+
+        // Acknowledgements of an earlier sender with the same peer
+        if (reliable_format::decodeSequence(ack) != _epoch)
+            return false;
+
+        const uint16_t cumulative = reliable_format::decodeSequence(ack + 2);
+        const uint8_t* bitmap = ack + 4;
+
+        // Ignore stale or corrupt acknowledgements beyond what was sent
+        const uint16_t acked = uint16_t(cumulative - _base);
+        if (acked > inFlight())
+            return false;
+
+        for (uint16_t seq = _base; seq != cumulative; ++seq)
+            _slots[seq % window].acked = true;
+
+        // Highest frame the peer holds beyond the cumulative point
+        int highest = -1;
+        for (size_t i = 0; i < window && i < size_t(uint16_t(_next - cumulative)); ++i)
+        {
+            if (bitmap[i / 8] & (1 << (i % 8)))
+            {
+                _slots[uint16_t(cumulative + i) % window].acked = true;
+                highest = int(i);
+            }
+        }
+
+        bool nack = false;
+        for (int i = 0; i < highest; ++i)
+        {
+            slot& s = _slots[uint16_t(cumulative + i) % window];
+            if (!s.acked && !s.nacked)
+            {
+                // Retransmit once per NACK, the timer handles later losses
+                s.nacked = true;
+                s.deadline = clock::time_point();
+                nack = true;
+            }
+        }
+
+        while (_base != _next && _slots[_base % window].acked)
+            ++_base;
+
+        return nack;
+    }
+
+    // Calls resend(seq, frame, bytes) for every frame whose timer expired,
+    // returns the number resent
+    template <typename function>
+    size_t retransmit(clock::time_point now, clock::duration timeout, function resend)
+    {
+        size_t frames = 0;
+        for (uint16_t seq = _base; seq != _next; ++seq)
+        {
+            slot& s = _slots[seq % window];
+            if (s.acked || s.deadline > now)
+                continue;
+
+            if (s.deadline != clock::time_point())
+                s.nacked = false;
+
+            s.deadline = now + timeout;
+            resend(seq, s.data, s.size);
+            ++frames;
+        }
+
+        return frames;
+    }
+
+private:
+    struct slot
+    {
+        uint8_t data[frame_size];
+        size_t size;
+        clock::time_point deadline;
+        bool acked;
+        bool nacked;
+    };
+
+    static uint16_t newEpoch()
+    {
+        const uint64_t t = uint64_t(std::chrono::system_clock::now().time_since_epoch().count());
+        return uint16_t(t ^ (t >> 16) ^ (t >> 32) ^ (t >> 48));
+    }
+
+    uint16_t _epoch;
+    uint16_t _base;
+    uint16_t _next;
+    slot _slots[window];
+};
+
+// Receive window: buffers frames that arrive ahead of a gap so they can be
+// delivered in sequence order, exactly once
+template <size_t window, size_t frame_size>
+class reliable_receiver
+{
+public:
+    reliable_receiver()
+        : _epoch(0)
+        , _previous_epoch(0)
+        , _expected(0)
+        , _synced(false)
+    {
+        clear();
+    }
+
+    // Stores a frame from a RELIABLE payload (without the control type
+    // byte), returns false for duplicates and frames outside the window
+    bool add(const uint8_t* payload, size_t bytes)
+    {
+        if (bytes < reliable_format::DATA_PREFIX_SIZE - 1)
+            return false;
+
+        const uint16_t epoch = reliable_format::decodeSequence(payload);
+        const uint16_t seq = reliable_format::decodeSequence(payload + 2);
+        payload += 4;
+        bytes -= 4;
+
+        if (!_synced || epoch != _epoch)
+        {
+            // Late frames of the sender we moved on from
+            if (_synced && epoch == _previous_epoch)
+                return false;
+
+            // A new sender starts at 0. Joining one that has been running
+            // for more than a window, only what follows can be delivered.
+            _previous_epoch = _epoch;
+            _epoch = epoch;
+            _expected = seq < window ? 0 : seq;
+            _synced = true;
+            clear();
+        }
+
+        const uint16_t offset = uint16_t(seq - _expected);
+        if (offset >= window || bytes > frame_size)
+            return false;
+
+        slot& s = _slots[seq % window];
+        if (s.present)
+            return false;
+
+        memcpy(s.data, payload, bytes);
+        s.size = bytes;
+        s.present = true;
+
+        return true;
+    }
+
+    // Calls deliver(frame, bytes) for every frame now in sequence
+    template <typename function>
+    void deliver(function deliver)
+    {
+        for (;;)
+        {
+            slot& s = _slots[_expected % window];
+            if (!s.present)
+                break;
+
+            s.present = false;
+            ++_expected;
+            deliver(s.data, s.size);
+        }
+    }
+
+    // Writes the ACK payload, returns its size
+    size_t writeAck(uint8_t* buf) const
+    {
+        buf[0] = control_frame::ACK;
+        reliable_format::encodeSequence(buf + 1, _epoch);
+        reliable_format::encodeSequence(buf + 3, _expected);
+
+        uint8_t* bitmap = buf + reliable_format::ACK_PREFIX_SIZE;
+        memset(bitmap, 0, window / 8);
+        for (size_t i = 0; i < window; ++i)
+        {
+            if (_slots[uint16_t(_expected + i) % window].present)
+                bitmap[i / 8] |= uint8_t(1 << (i % 8));
+        }
+
+        return reliable_format::ackSize(window);
+    }
+
+private:
+    struct slot
+    {
+        uint8_t data[frame_size];
+        size_t size;
+        bool present;
+    };
+
+    void clear()
+    {
+        for (size_t i = 0; i < window; ++i)
+            _slots[i].present = false;
+    }
+
+    uint16_t _epoch;
+    uint16_t _previous_epoch;
+    uint16_t _expected;
+    bool _synced;
+    slot _slots[window];
+};
+
+template <size_t frame_size>
+class reliable_sender<0, frame_size>
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    uint16_t epoch() const { return 0; }
+    bool full() const { return false; }
+    size_t inFlight() const { return 0; }
+    uint16_t push(const uint8_t*, size_t, clock::time_point) { return 0; }
+    bool acknowledge(const uint8_t*, size_t) { return false; }
+
+    template <typename function>
+    size_t retransmit(clock::time_point, clock::duration, function) { return 0; }
+};
+
+template <size_t frame_size>
+class reliable_receiver<0, frame_size>
+{
+public:
+    bool add(const uint8_t*, size_t) { return false; }
+
+    template <typename function>
+    void deliver(function) {}
+
+    size_t writeAck(uint8_t*) const { return 0; }
+};
+
+}
+
+#endif // DATATRANSFER_RELIABLE_DELIVERY_HPP
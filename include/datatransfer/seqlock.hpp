@@ -0,0 +1,61 @@
+#ifndef DATATRANSFER_SEQLOCK_HPP
+#define DATATRANSFER_SEQLOCK_HPP
+
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+
+namespace datatransfer {
+
+// Single value slot guarded by a sequence counter. Readers never block the
+// writer; they retry if the value changed while being copied. Writers
+// exclude each other by moving the counter from even to odd. T must be
+// trivially copyable.
+template <typename T>
+class seqlock
+{
+public:
+    seqlock()
+        : _sequence(0)
+    {
+        memset(&_value, 0, sizeof(T));
+    }
+
+    void store(const T& t)
+    {
+        uint64_t s = _sequence.load(std::memory_order_relaxed);
+        while ((s & 1) != 0 || !_sequence.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+            s = _sequence.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_value, &t, sizeof(T));
+        _sequence.store(s + 2, std::memory_order_release);
+    }
+
+    // Returns the version of the copied value, 0 if nothing was stored yet
+    uint64_t load(T& t) const
+    {
+        uint64_t before, after;
+        do
+        {
+            before = _sequence.load(std::memory_order_acquire);
+            memcpy(&t, &_value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = _sequence.load(std::memory_order_relaxed);
+        }
+        while ((before & 1) != 0 || before != after);
+
+        return before / 2;
+    }
+
+    uint64_t version() const { return _sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    alignas(64) std::atomic<uint64_t> _sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type _value;
+};
+
+}
+
+#endif // DATATRANSFER_SEQLOCK_HPP
@@ -0,0 +1,354 @@
+#ifndef DATATRANSFER_SHM_STREAM_HPP
+#define DATATRANSFER_SHM_STREAM_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <stdint.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace datatransfer {
+
+// Single producer/single consumer byte ring placed in shared memory. Both
+// sides only touch the shared indices in the steady state; a futex is used
+// to sleep when the ring is empty (reader) or full (writer), and the other
+// side only makes the wake-up syscall when someone is actually sleeping.
+template <size_t N>
+class spsc_ring
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Ring size must be a power of two");
+
+    enum
+    {
+        SPIN_COUNT = 1024
+    };
+
+public:
+    spsc_ring()
+        : _head(0)
+        , _tail(0)
+        , _reader_waiting(0)
+        , _writer_waiting(0)
+        , _closed(0)
+    {}
+
+    static constexpr size_t capacity() { return N; }
+
+    // Returns the number of bytes copied out, 0 if the ring is empty
+    size_t read(char* buf, size_t n)
+    {
+        const uint64_t head = _head.load(std::memory_order_relaxed);
+        const uint64_t available = _tail.load(std::memory_order_acquire) - head;
+        if (n > available)
+            n = available;
+
+        copyOut(head, buf, n);
+        _head.store(head + n, std::memory_order_release);
+
+        if (n > 0 && sleeping(_writer_waiting))
+            wake(_writer_waiting);
+
+        return n;
+    }
+
+    // Returns the number of bytes copied in, 0 if the ring is full
+    size_t write(const char* buf, size_t n)
+    {
+        const uint64_t tail = _tail.load(std::memory_order_relaxed);
+        const uint64_t space = N - (tail - _head.load(std::memory_order_acquire));
+        if (n > space)
+            n = space;
+
+        copyIn(tail, buf, n);
+        _tail.store(tail + n, std::memory_order_release);
+
+        if (n > 0 && sleeping(_reader_waiting))
+            wake(_reader_waiting);
+
+        return n;
+    }
+
+    bool empty() const { return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_relaxed); }
+    bool full() const { return _tail.load(std::memory_order_relaxed) - _head.load(std::memory_order_acquire) == N; }
+
+    // Blocks until the ring has data or the writer closed it
+    void waitReadable()
+    {
+        wait(_reader_waiting, [this] { return !empty() || closed(); });
+    }
+
+    // Blocks until the ring has space or the reader closed it
+    void waitWritable()
+    {
+        wait(_writer_waiting, [this] { return !full() || closed(); });
+    }
+
+    void close()
+    {
+        _closed.store(1, std::memory_order_seq_cst);
+        wake(_reader_waiting);
+        wake(_writer_waiting);
+    }
+
+    bool closed() const { return _closed.load(std::memory_order_acquire) != 0; }
+
+private:
+    void copyOut(uint64_t pos, char* buf, size_t n) const
+    {
+        const size_t offset = pos & (N - 1);
+        const size_t first = n < N - offset ? n : N - offset;
+        memcpy(buf, &_data[offset], first);
+        memcpy(buf + first, &_data[0], n - first);
+    }
+
+    void copyIn(uint64_t pos, const char* buf, size_t n)
+    {
+        const size_t offset = pos & (N - 1);
+        const size_t first = n < N - offset ? n : N - offset;
+        memcpy(&_data[offset], buf, first);
+        memcpy(&_data[0], buf + first, n - first);
+    }
+
+    template <typename predicate>
+    static void wait(std::atomic<uint32_t>& waiting, predicate ready)
+    {
+        for (int i = 0; i < SPIN_COUNT; ++i)
+        {
+            if (ready())
+                return;
+        }
+
+        while (!ready())
+        {
+            waiting.store(1, std::memory_order_seq_cst);
+            if (!ready())
+                syscall(SYS_futex, &waiting, FUTEX_WAIT, 1, nullptr, nullptr, 0);
+            waiting.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Orders our index update before the flag check, pairing with the
+    // store-then-recheck in wait()
+    static bool sleeping(const std::atomic<uint32_t>& waiting)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return waiting.load(std::memory_order_relaxed) != 0;
+    }
+
+    static void wake(std::atomic<uint32_t>& waiting)
+    {
+        waiting.store(0, std::memory_order_relaxed);
+        syscall(SYS_futex, &waiting, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    alignas(64) std::atomic<uint64_t> _head;
+    alignas(64) std::atomic<uint64_t> _tail;
+    alignas(64) std::atomic<uint32_t> _reader_waiting;
+    alignas(64) std::atomic<uint32_t> _writer_waiting;
+    std::atomic<uint32_t> _closed;
+    alignas(64) char _data[N];
+};
+
+// input_output_stream over a pair of spsc_rings in a named POSIX shared
+// memory segment, for peers on the same host. One side creates the segment,
+// the other opens it; each direction has exactly one reader and one writer.
+// Opening waits up to OPEN_TIMEOUT_MS for the creator to finish setting the
+// segment up and fails (good() is false) if it never does or was created
+// with another layout.
+template <size_t N = (1 << 20)>
+class shm_stream
+{
+    enum : uint32_t
+    {
+        MAGIC = 0x48535444, // "DTSH"
+        VERSION = 1,
+        OPEN_TIMEOUT_MS = 1000
+    };
+
+    struct segment
+    {
+        segment()
+            : magic(0)
+            , version(VERSION)
+            , ring_size(N)
+        {}
+
+        // Published last by the creator, once everything else is set up
+        std::atomic<uint32_t> magic;
+        uint32_t version;
+        uint64_t ring_size;
+        spsc_ring<N> rings[2];
+    };
+
+public:
+    using char_type = char;
+
+    enum mode
+    {
+        CREATE,
+        OPEN
+    };
+
+    shm_stream(const char* name, mode m)
+        : _segment(nullptr)
+        , _rx(nullptr)
+        , _tx(nullptr)
+        , _owner(m == CREATE)
+        , _eof(false)
+    {
+        strncpy(_name, name, sizeof(_name) - 1);
+        _name[sizeof(_name) - 1] = '\0';
+
+        const int fd = shm_open(_name, _owner ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+        if (fd < 0)
+            return;
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(OPEN_TIMEOUT_MS);
+
+        // Touching pages past the end of the object would raise SIGBUS
+        if (_owner ? ftruncate(fd, sizeof(segment)) == 0 : waitForSize(fd, deadline))
+        {
+            void* p = mmap(nullptr, sizeof(segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                if (_owner)
+                {
+                    _segment = new (p) segment();
+                    _segment->magic.store(MAGIC, std::memory_order_release);
+                }
+                else if (waitForCreator(static_cast<segment*>(p), deadline))
+                {
+                    _segment = static_cast<segment*>(p);
+                }
+                else
+                {
+                    munmap(p, sizeof(segment));
+                }
+            }
+        }
+
+        ::close(fd);
+
+        if (_segment != nullptr)
+        {
+            _tx = &_segment->rings[_owner ? 0 : 1];
+            _rx = &_segment->rings[_owner ? 1 : 0];
+        }
+    }
+
+    ~shm_stream()
+    {
+        if (_segment != nullptr)
+        {
+            _tx->close();
+            _rx->close();
+            munmap(_segment, sizeof(segment));
+        }
+
+        if (_owner)
+            shm_unlink(_name);
+    }
+
+    bool good() const { return _segment != nullptr && !_eof; }
+    bool eof() const { return _eof; }
+
+    void clear() { _eof = false; }
+
+    // Returns the number of bytes read, 0 if nothing is available
+    size_t readsome(char_type* buf, size_t n)
+    {
+        const size_t r = _rx->read(buf, n);
+        if (r == 0 && _rx->closed() && _rx->empty())
+            _eof = true;
+
+        return r;
+    }
+
+    int get()
+    {
+        char_type c;
+        while (good())
+        {
+            if (readsome(&c, 1) == 1)
+                return static_cast<unsigned char>(c);
+
+            if (!_eof)
+                _rx->waitReadable();
+        }
+
+        return -1;
+    }
+
+    shm_stream& write(const char_type* buf, size_t n)
+    {
+        // Bytes written after the peer went away are discarded
+        while (n > 0 && good() && !_tx->closed())
+        {
+            const size_t w = _tx->write(buf, n);
+            buf += w;
+            n -= w;
+
+            if (n > 0)
+                _tx->waitWritable();
+        }
+
+        return *this;
+    }
+
+    shm_stream& flush() { return *this; }
+
+private:
+    shm_stream(const shm_stream&) = delete;
+    shm_stream& operator=(const shm_stream&) = delete;
+
+    static bool waitForSize(int fd, std::chrono::steady_clock::time_point deadline)
+    {
+        struct stat st;
+        while (fstat(fd, &st) == 0)
+        {
+            if (size_t(st.st_size) >= sizeof(segment))
+                return true;
+
+            if (std::chrono::steady_clock::now() > deadline)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return false;
+    }
+
+    static bool waitForCreator(const segment* s, std::chrono::steady_clock::time_point deadline)
+    {
+        while (s->magic.load(std::memory_order_acquire) != MAGIC)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return s->version == VERSION && s->ring_size == N;
+    }
+
+    char _name[256];
+    segment* _segment;
+    spsc_ring<N>* _rx;
+    spsc_ring<N>* _tx;
+    bool _owner;
+    bool _eof;
+};
+
+}
+
+#endif // DATATRANSFER_SHM_STREAM_HPP
@@ -15,7 +15,7 @@ public:
     template <int N>
     void signal(const typename serialization_policy::template data<N>::type& t)
     {
-        auto func = RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_callbacks);
+        auto& func = RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_callbacks);
 
         if (func != nullptr) func(t);
     }
@@ -26,6 +26,12 @@ public:
         RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_callbacks) = func;
     }
 
+    template <int N>
+    void deregisterHandler()
+    {
+        RetrieveHelper<N,1,serialization_policy::NUMBER_OF_MESSAGES>::retrieve(_callbacks) = nullptr;
+    }
+
 protected:
     template <int N, int count>
     struct FunctionHelper
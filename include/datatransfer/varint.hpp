@@ -0,0 +1,168 @@
+#ifndef DATATRANSFER_VARINT_HPP
+#define DATATRANSFER_VARINT_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace datatransfer {
+
+// LEB128 variable length integers, zigzag mapped when signed
+struct leb128
+{
+    static constexpr size_t MAX_SIZE = 10;
+
+    template <typename T>
+    static uint64_t encode_value(T t)
+    {
+        return encode_value(t, std::is_signed<T>());
+    }
+
+    template <typename T>
+    static T decode_value(uint64_t v)
+    {
+        return decode_value<T>(v, std::is_signed<T>());
+    }
+
+    static size_t encoded_size(uint64_t v)
+    {
+        // One byte per started group of 7 significant bits
+        const int bits = 64 - count_leading_zeros(v | 1);
+        return size_t(bits + 6) / 7;
+    }
+
+    static size_t encode(uint64_t v, uint8_t* out)
+    {
+        size_t n = 0;
+        while (v >= 0x80)
+        {
+            out[n++] = uint8_t(v) | 0x80;
+            v >>= 7;
+        }
+        out[n++] = uint8_t(v);
+
+        return n;
+    }
+
+    // Returns the number of bytes consumed, 0 if the input is truncated or
+    // longer than MAX_SIZE
+    static size_t decode(const uint8_t* p, size_t available, uint64_t& v)
+    {
+        if (available >= 8)
+        {
+            // Locate the terminating byte in one 64 bit load and gather the
+            // 7 bit groups without a per byte loop
+            uint64_t word;
+            memcpy(&word, p, 8);
+
+            const uint64_t stops = ~word & 0x8080808080808080ULL;
+            if (stops != 0)
+            {
+                const int bits = count_trailing_zeros(stops) + 1;
+                if (bits < 64)
+                    word &= (uint64_t(1) << bits) - 1;
+
+                v = gather(word);
+                return size_t(bits) >> 3;
+            }
+        }
+
+        return decode_slow(p, available, v);
+    }
+
+private:
+    template <typename T>
+    static uint64_t encode_value(T t, std::false_type) { return uint64_t(t); }
+
+    template <typename T>
+    static uint64_t encode_value(T t, std::true_type)
+    {
+        const int64_t n = t;
+        return (uint64_t(n) << 1) ^ uint64_t(n >> 63);
+    }
+
+    template <typename T>
+    static T decode_value(uint64_t v, std::false_type) { return T(v); }
+
+    template <typename T>
+    static T decode_value(uint64_t v, std::true_type)
+    {
+        return T(int64_t(v >> 1) ^ -int64_t(v & 1));
+    }
+
+    static uint64_t gather(uint64_t word)
+    {
+#if defined(__BMI2__)
+        return _pext_u64(word, 0x7F7F7F7F7F7F7F7FULL);
+#else
+        word &= 0x7F7F7F7F7F7F7F7FULL;
+        word = ((word & 0x7F007F007F007F00ULL) >> 1) | (word & 0x007F007F007F007FULL);
+        word = ((word & 0x3FFF00003FFF0000ULL) >> 2) | (word & 0x00003FFF00003FFFULL);
+        word = ((word & 0x0FFFFFFF00000000ULL) >> 4) | (word & 0x000000000FFFFFFFULL);
+        return word;
+#endif
+    }
+
+    static size_t decode_slow(const uint8_t* p, size_t available, uint64_t& v)
+    {
+        v = 0;
+        const size_t limit = available < MAX_SIZE ? available : MAX_SIZE;
+
+        for (size_t i = 0; i < limit; ++i)
+        {
+            v |= uint64_t(p[i] & 0x7F) << (7 * i);
+            if ((p[i] & 0x80) == 0)
+                return i + 1;
+        }
+
+        return 0;
+    }
+
+    static int count_leading_zeros(uint64_t v)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(v);
+#else
+        int n = 0;
+        for (uint64_t bit = uint64_t(1) << 63; bit != 0 && (v & bit) == 0; bit >>= 1)
+            ++n;
+        return n;
+#endif
+    }
+
+    static int count_trailing_zeros(uint64_t v)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(v);
+#else
+        int n = 0;
+        for (; (v & 1) == 0; v >>= 1)
+            ++n;
+        return n;
+#endif
+    }
+};
+
+// Marks a single integer field for LEB128 encoding: p % varint(counter);
+template <typename T>
+struct varint_field
+{
+    static_assert(std::is_integral<T>::value, "Only integers can be varint encoded");
+
+    T& value;
+};
+
+template <typename T>
+varint_field<T> varint(T& value)
+{
+    return varint_field<T>{ value };
+}
+
+}
+
+#endif // DATATRANSFER_VARINT_HPP
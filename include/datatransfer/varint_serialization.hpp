@@ -0,0 +1,159 @@
+#ifndef DATATRANSFER_VARINT_SERIALIZATION_HPP
+#define DATATRANSFER_VARINT_SERIALIZATION_HPP
+
+#include "binary_serialization.hpp"
+
+namespace datatransfer
+{
+
+// Same wire format as binary_serialization except that every integer wider
+// than a byte is LEB128 encoded (zigzag when signed). Encoded sizes depend
+// on the values, so the protocol needs a header type with a length field
+// (length_packet_header).
+struct varint_serialization
+{
+    // Types that are still copied verbatim
+    template <typename T>
+    struct is_fixed_width
+        : std::integral_constant<bool, std::is_floating_point<T>::value
+                                       || (std::is_arithmetic<T>::value && sizeof(T) == 1)>
+    {};
+
+    template <typename T, size_t N>
+    struct is_fixed_width<T[N]> : is_fixed_width<T> {};
+
+    class size_policy_base : public binary_serialization::size_policy_base
+    {
+    public:
+        static constexpr bool FIXED_WIDTH = false;
+
+        // Widest case is a 16 bit integer taking 3 bytes
+        template <typename T>
+        static constexpr data_type wire_size_bound() { return (sizeof(T) * 3 + 1) / 2; }
+
+        // Encoded size of a zero initialised T
+        template <typename T>
+        static data_type wire_size()
+        {
+            static const data_type size = measure<T>();
+            return size;
+        }
+
+    private:
+        template <typename T>
+        static data_type measure();
+    };
+
+    template <typename policy, typename ...Args>
+    class primitives : public policy
+    {
+    public:
+        template <typename T>
+        using bitwise = is_fixed_width<T>;
+
+        primitives(Args ...args)
+            : policy(args...)
+        {}
+
+        template <typename T>
+        primitives<policy, Args...>& operator% (T& x)
+        {
+            operate(x);
+
+            return *this;
+        }
+
+        template <typename T, int N>
+        primitives<policy, Args...>& operator% (T (&x)[N])
+        {
+            static_assert(N > 0, "Array size must be greater than 0");
+
+            sequence(x, N);
+
+            return *this;
+        }
+
+        template <typename T>
+        primitives<policy, Args...>& operator% (varint_field<T> x)
+        {
+            policy::varint_action(x.value);
+
+            return *this;
+        }
+
+        template <typename T>
+        primitives<policy, Args...>& sequence(T* x, size_t count)
+        {
+            sequence(x, count, bitwise<T>());
+
+            return *this;
+        }
+
+        template <typename T>
+        void operate(T& t)
+        {
+            t.method(*this);
+        }
+
+        template <typename T, int N>
+        void operate(T (&x)[N])
+        {
+            sequence(x, N);
+        }
+
+        void operate(float& x)			{ policy::action(x); }
+        void operate(double& x)			{ policy::action(x); }
+        void operate(bool& x)			{ policy::action(x); }
+        void operate(char& x)			{ policy::action(x); }
+        void operate(int8_t& x)			{ policy::action(x); }
+        void operate(uint8_t& x)		{ policy::action(x); }
+        void operate(int16_t& x)        { policy::varint_action(x); }
+        void operate(uint16_t& x)       { policy::varint_action(x); }
+        void operate(int32_t& x)        { policy::varint_action(x); }
+        void operate(uint32_t& x)       { policy::varint_action(x); }
+        void operate(int64_t& x)        { policy::varint_action(x); }
+        void operate(uint64_t& x)		{ policy::varint_action(x); }
+
+    private:
+        template <typename T>
+        void sequence(T* x, size_t count, std::true_type) { policy::action(x, count); }
+
+        template <typename T>
+        void sequence(T* x, size_t count, std::false_type)
+        {
+            for (size_t i = 0; i < count; ++i)
+                operate(x[i]);
+        }
+    };
+
+    template <typename output_stream>
+    using write_policy = primitives<binary_serialization::write_policy_base<output_stream>, output_stream&>;
+
+    template <typename char_type, int N>
+    using read_policy = primitives<binary_serialization::read_policy_base<char_type, N>,
+                                   typename binary_serialization::read_policy_base<char_type, N>::stream_type&>;
+
+    using checksum_policy = primitives<binary_serialization::checksum_policy_base, binary_serialization::checksum_policy_base::data_type&>;
+    using crc16_policy = primitives<binary_serialization::crc_policy_base<crc16_ccitt>, crc16_ccitt::value_type&>;
+    using crc32c_policy = primitives<binary_serialization::crc_policy_base<crc32c>, crc32c::value_type&>;
+    using size_policy = primitives<size_policy_base>;
+
+    template <typename T>
+    static size_t wire_size() { return size_policy::wire_size<T>(); }
+
+    template <typename T>
+    static constexpr size_t wire_size_bound() { return size_policy::wire_size_bound<T>(); }
+};
+
+template <typename T>
+varint_serialization::size_policy_base::data_type varint_serialization::size_policy_base::measure()
+{
+    alignas(T) uint8_t storage[sizeof(T)] = {};
+    size_policy s;
+    s.operate(*reinterpret_cast<T*>(storage));
+    return s.size();
+}
+
+}
+
+#endif // DATATRANSFER_VARINT_SERIALIZATION_HPP
@@ -0,0 +1,132 @@
+// Bulk copied bitwise serializable types encode exactly like the same
+// fields written one at a time, and decode back to the same values
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+struct fields
+{
+    float a[8];
+    int32_t b;
+    uint16_t c[4];
+    uint8_t d[3];
+    uint8_t e;
+
+    template <typename P>
+    void method(P& p) { p % a; p % b; p % c; p % d; p % e; }
+};
+
+static_assert(sizeof(fields) == 48, "fields must have no padding");
+
+struct bitwise_fields : fields {};
+
+}
+
+namespace datatransfer {
+template <> struct is_bitwise_serializable<bitwise_fields> : std::true_type {};
+}
+
+namespace {
+
+template <typename message>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 64;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = message;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+template <typename message>
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<message>,
+                                              datatransfer::callback_handler<protocol<message>>>;
+
+fields sample(int i)
+{
+    fields f;
+    for (int k = 0; k < 8; ++k)
+        f.a[k] = float(i) * 0.25f + float(k);
+    f.b = -i * 1000;
+    for (int k = 0; k < 4; ++k)
+        f.c[k] = uint16_t(i * 4 + k);
+    for (int k = 0; k < 3; ++k)
+        f.d[k] = uint8_t(i + k);
+    f.e = uint8_t(~i);
+    return f;
+}
+
+template <typename message>
+std::string encode(int frames)
+{
+    std::stringstream out;
+    connector<message> tx(out);
+    for (int i = 0; i < frames; ++i)
+    {
+        message m;
+        static_cast<fields&>(m) = sample(i);
+        tx.template send<1>(m);
+    }
+
+    return out.str();
+}
+
+int received;
+
+template <typename message>
+void onFields(const message& m)
+{
+    const fields expected = sample(received++);
+    CHECK(memcmp(&m, &expected, sizeof(fields)) == 0);
+}
+
+template <typename message>
+void decode(const std::string& wire, int frames)
+{
+    received = 0;
+
+    std::stringstream unused;
+    connector<message> rx(unused);
+    rx.template registerMessageHandler<1>(&onFields<message>);
+    rx.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+
+    CHECK(received == frames);
+}
+
+}
+
+int main()
+{
+    const int frames = 20;
+    const std::string per_field = encode<fields>(frames);
+    const std::string bitwise = encode<bitwise_fields>(frames);
+
+    CHECK(per_field == bitwise);
+
+    decode<fields>(bitwise, frames);
+    decode<bitwise_fields>(per_field, frames);
+
+    return 0;
+}
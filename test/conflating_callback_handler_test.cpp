@@ -0,0 +1,160 @@
+// conflating_callback_handler: a burst of updates to a conflated type runs
+// its handler once per parsed chunk with the newest value, other types are
+// delivered one by one, and latest() never returns a torn value
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/conflating_callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/std_function_callback_handler.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+struct quote
+{
+    uint32_t sequence;
+    uint32_t check;
+
+    template <typename P>
+    void method(P& p) { p % sequence; p % check; }
+};
+
+// 1: conflated quote, 2: ordinary quote
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 2;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    template <int N, int = 0>
+    struct data
+    {
+        using type = quote;
+        static const int length = 1;
+    };
+
+    template <int dummy>
+    struct data<1, dummy>
+    {
+        using type = quote;
+        static const int length = 1;
+        static const bool conflate = true;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using handler = datatransfer::conflating_callback_handler<protocol, datatransfer::std_function_callback_handler<protocol>>;
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, handler>;
+
+quote makeQuote(uint32_t sequence)
+{
+    return quote{ sequence, sequence * 7 + 1 };
+}
+
+// 1000 conflated quotes with an ordinary one after every 200th
+std::string burst()
+{
+    std::stringstream out;
+    connector tx(out);
+    for (uint32_t i = 1; i <= 1000; ++i)
+    {
+        quote q = makeQuote(i);
+        tx.send<1>(q);
+        if (i % 200 == 0)
+            tx.send<2>(q);
+    }
+
+    return out.str();
+}
+
+void testBurst()
+{
+    const std::string wire = burst();
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(wire.data());
+
+    std::stringstream unused;
+    connector rx(unused);
+
+    std::vector<uint32_t> conflated;
+    std::vector<uint32_t> ordinary;
+    rx.registerMessageHandler<1>([&conflated](const quote& q) { conflated.push_back(q.sequence); });
+    rx.registerMessageHandler<2>([&ordinary](const quote& q) { ordinary.push_back(q.sequence); });
+
+    quote q;
+    CHECK(rx.messageHandlers().latest<1>(q) == 0);
+
+    rx.feed(bytes, wire.size());
+    CHECK(conflated.size() == 1 && conflated[0] == 1000);
+    CHECK(ordinary.size() == 5);
+    for (size_t i = 0; i < ordinary.size(); ++i)
+        CHECK(ordinary[i] == 200 * (i + 1));
+
+    const uint64_t version = rx.messageHandlers().latest<1>(q);
+    CHECK(version != 0);
+    CHECK(q.sequence == 1000 && q.check == makeQuote(1000).check);
+
+    // Handlers do not run again without a new update
+    rx.messageHandlers().dispatchPending();
+    CHECK(conflated.size() == 1);
+
+    // One run per chunk, each with the newest value in it; values only grow
+    conflated.clear();
+    const size_t half = wire.size() / 2;
+    rx.feed(bytes, half);
+    rx.feed(bytes + half, wire.size() - half);
+    CHECK(conflated.size() == 2);
+    CHECK(conflated[0] < conflated[1] && conflated[1] == 1000);
+    CHECK(rx.messageHandlers().latest<1>(q) > version);
+}
+
+// A reader polling latest() while the receiver keeps updating the slot
+void testConcurrentLatest()
+{
+    handler h;
+    std::atomic<bool> done(false);
+
+    std::thread reader([&]
+    {
+        uint32_t last = 0;
+        while (!done.load(std::memory_order_acquire))
+        {
+            quote q;
+            if (h.latest<1>(q) != 0)
+            {
+                CHECK(q.check == makeQuote(q.sequence).check);
+                CHECK(q.sequence >= last);
+                last = q.sequence;
+            }
+        }
+    });
+
+    for (uint32_t i = 1; i <= 1000000; ++i)
+        h.signal<1>(makeQuote(i));
+
+    done.store(true, std::memory_order_release);
+    reader.join();
+}
+
+}
+
+int main()
+{
+    testBurst();
+    testConcurrentLatest();
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+// CRC check values, chaining, hardware against portable CRC-32C, and the
+// CRC checksum policies rejecting corrupted frames
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/crc.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+using datatransfer::crc16_ccitt;
+using datatransfer::crc32c;
+
+namespace {
+
+struct reading
+{
+    uint32_t sensor;
+    float value;
+
+    template <typename P>
+    void method(P& p) { p % sensor; p % value; }
+};
+
+template <typename crc_policy>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = reading;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = crc_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+int received;
+
+void onReading(const reading& r)
+{
+    CHECK(r.sensor == uint32_t(received) && r.value == float(received) * 1.5f);
+    ++received;
+}
+
+int delivered;
+
+void onCheckedReading(const reading& r)
+{
+    CHECK(r.sensor != 1);
+    ++delivered;
+}
+
+void testCheckValues()
+{
+    const char* check = "123456789";
+
+    CHECK(crc16_ccitt::update(crc16_ccitt::INITIAL, check, 9) == 0x29B1);
+    CHECK(crc32c::update(crc32c::INITIAL, check, 9) == 0xE3069283);
+    CHECK(crc32c::update_portable(crc32c::INITIAL, check, 9) == 0xE3069283);
+}
+
+// Every length and alignment the word loops and their tails can see
+void testChaining()
+{
+    std::vector<uint8_t> data(300);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = uint8_t(i * 131 + 7);
+
+    for (size_t offset = 0; offset < 8; ++offset)
+    {
+        for (size_t bytes = 0; bytes + offset <= 200; ++bytes)
+        {
+            const uint8_t* p = data.data() + offset;
+            const uint32_t whole = crc32c::update(crc32c::INITIAL, p, bytes);
+            CHECK(whole == crc32c::update_portable(crc32c::INITIAL, p, bytes));
+
+            const size_t split = bytes / 3;
+            CHECK(whole == crc32c::update(crc32c::update(crc32c::INITIAL, p, split), p + split, bytes - split));
+            CHECK(crc16_ccitt::update(crc16_ccitt::INITIAL, p, bytes)
+                  == crc16_ccitt::update(crc16_ccitt::update(crc16_ccitt::INITIAL, p, split), p + split, bytes - split));
+        }
+    }
+}
+
+template <typename crc_policy>
+void testConnector()
+{
+    using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<crc_policy>,
+                                                  datatransfer::callback_handler<protocol<crc_policy>>>;
+    const int frames = 10;
+
+    std::stringstream out;
+    connector tx(out);
+    for (int i = 0; i < frames; ++i)
+    {
+        reading r = { uint32_t(i), float(i) * 1.5f };
+        tx.template send<1>(r);
+    }
+    const std::string wire = out.str();
+    const size_t frame_size = wire.size() / frames;
+
+    received = 0;
+    std::stringstream unused;
+    connector rx(unused);
+    rx.template registerMessageHandler<1>(&onReading);
+    rx.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+    CHECK(received == frames);
+
+    // A flipped payload bit in the second frame must drop just that frame
+    std::string corrupted = wire;
+    corrupted[frame_size + frame_size / 2] ^= 0x10;
+
+    delivered = 0;
+    connector checked(unused);
+    checked.template registerMessageHandler<1>(&onCheckedReading);
+    checked.feed(reinterpret_cast<const uint8_t*>(corrupted.data()), corrupted.size());
+    CHECK(delivered == frames - 1);
+}
+
+}
+
+int main()
+{
+    testCheckValues();
+    testChaining();
+    testConnector<datatransfer::binary_serialization::crc16_policy>();
+    testConnector<datatransfer::binary_serialization::crc32c_policy>();
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+// datagram_stream over a UDP loopback pair: sends are queued until flush()
+// or a full queue, batches pack several frames per datagram, and a datagram
+// that would be truncated is refused
+#include <cstdint>
+#include <mutex>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/datagram_stream.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+struct telemetry
+{
+    uint32_t id;
+    uint16_t value;
+    uint8_t flags;
+
+    template <typename P>
+    void method(P& p) { p % id; p % value; p % flags; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = telemetry;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using stream = datatransfer::datagram_stream<>;
+using connector = datatransfer::p2p_connector<std::mutex, stream, protocol, datatransfer::callback_handler<protocol>, 1472>;
+
+uint32_t received;
+uint32_t next_id;
+
+void onTelemetry(const telemetry& t)
+{
+    CHECK(t.id == next_id);
+    CHECK(t.value == 2 && t.flags == 3);
+    ++next_id;
+    ++received;
+}
+
+// Two UDP sockets on 127.0.0.1 connected to each other
+void loopbackPair(int fds[2])
+{
+    sockaddr_in addresses[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        CHECK(fds[i] >= 0);
+
+        sockaddr_in any = {};
+        any.sin_family = AF_INET;
+        any.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        CHECK(bind(fds[i], reinterpret_cast<sockaddr*>(&any), sizeof(any)) == 0);
+
+        socklen_t length = sizeof(addresses[i]);
+        CHECK(getsockname(fds[i], reinterpret_cast<sockaddr*>(&addresses[i]), &length) == 0);
+    }
+
+    CHECK(connect(fds[0], reinterpret_cast<sockaddr*>(&addresses[1]), sizeof(addresses[1])) == 0);
+    CHECK(connect(fds[1], reinterpret_cast<sockaddr*>(&addresses[0]), sizeof(addresses[0])) == 0);
+}
+
+// Receives until count frames arrived, returns the number of datagrams
+size_t receiveFrames(connector& rx, uint32_t count)
+{
+    size_t datagrams = 0;
+    while (received < count)
+        datagrams += rx.readDatagrams(true);
+
+    return datagrams;
+}
+
+}
+
+int main()
+{
+    int fds[2];
+    loopbackPair(fds);
+
+    stream tx_stream(fds[0]);
+    stream rx_stream(fds[1]);
+    connector tx(tx_stream);
+    connector rx(rx_stream);
+    rx.registerMessageHandler<1>(&onTelemetry);
+
+    telemetry t = { 0, 2, 3 };
+
+    // Nothing leaves before flush()
+    for (t.id = 0; t.id < 10; ++t.id)
+        tx.send<1>(t);
+    CHECK(rx.readDatagrams(false) == 0);
+    tx.flush();
+    CHECK(receiveFrames(rx, 10) == 10);
+
+    // The 65th datagram does not fit the queue and pushes the first 64 out
+    received = 0;
+    for (int i = 0; i < 65; ++i, ++t.id)
+        tx.send<1>(t);
+    CHECK(receiveFrames(rx, 64) == 64);
+    tx.flush();
+    CHECK(receiveFrames(rx, 65) == 1);
+
+    // A batch packs as many frames into each datagram as the TX buffer holds
+    received = 0;
+    {
+        auto batch = tx.beginBatch();
+        for (int i = 0; i < 1000; ++i, ++t.id)
+            batch.send<1>(t);
+    }
+    tx.flush();
+    CHECK(receiveFrames(rx, 1000) < 100);
+
+    // A garbage datagram is dropped whole and does not disturb the next one
+    received = 0;
+    const uint8_t junk[] = { 0x55, 0xAA, 9 };
+    rx.feedDatagram(junk, sizeof(junk));
+    CHECK(received == 0);
+    tx.send<1>(t);
+    ++t.id;
+    tx.flush();
+    CHECK(receiveFrames(rx, 1) == 1);
+
+    // The peer would drop a truncated datagram, so it is never sent
+    char oversize[2000] = {};
+    tx_stream.write(oversize, sizeof(oversize));
+    CHECK(!tx_stream.good());
+
+    close(fds[0]);
+    close(fds[1]);
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Delta mode rebuilds every message exactly, and after a lost frame or
+// when joining late delivers nothing until the next keyframe
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/packet_types.h>
+#include "test_support.hpp"
+
+namespace {
+
+// Keeps every write, send() writes one frame at a time
+struct frame_recorder
+{
+    using char_type = char;
+
+    std::vector<std::string> frames;
+
+    bool good() const { return true; }
+    int get() { return -1; }
+
+    frame_recorder& write(const char_type* data, size_t n)
+    {
+        frames.push_back(std::string(data, n));
+        return *this;
+    }
+
+    frame_recorder& flush() { return *this; }
+};
+
+struct state
+{
+    uint64_t t;
+    float x, y, z;
+    uint32_t counter;
+    uint16_t mode;
+    uint16_t faults;
+    float battery;
+
+    template <typename P>
+    void method(P& p) { p % t; p % x; p % y; p % z; p % counter; p % mode; p % faults; p % battery; }
+};
+
+const int keyframe_interval = 10;
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 64;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    using header_type = datatransfer::length_packet_header;
+
+    template <int N>
+    struct data
+    {
+        using type = state;
+        static const int length = 1;
+        static const int keyframe_interval = ::keyframe_interval;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::crc16_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, frame_recorder, protocol, datatransfer::callback_handler<protocol>>;
+
+// Only some fields change from one frame to the next
+state sample(int i)
+{
+    state s = {};
+    s.t = uint64_t(i) * 10000;
+    s.x = 0.01f * i;
+    s.y = -0.02f * i;
+    s.z = 5.0f;
+    s.counter = uint32_t(i / 3);
+    s.mode = 3;
+    s.faults = i >= 50 ? 1 : 0;
+    s.battery = 12.5f;
+    return s;
+}
+
+std::vector<int> received;
+
+void onState(const state& s)
+{
+    const int i = int(s.t / 10000);
+    const state expected = sample(i);
+    CHECK(memcmp(&s, &expected, sizeof(state)) == 0);
+    received.push_back(i);
+}
+
+std::vector<int> deliver(const frame_recorder& sent, int first, int skipped)
+{
+    received.clear();
+
+    frame_recorder unused;
+    connector rx(unused);
+    rx.registerMessageHandler<1>(&onState);
+    for (int i = first; i < int(sent.frames.size()); ++i)
+    {
+        if (i != skipped)
+            rx.feed(reinterpret_cast<const uint8_t*>(sent.frames[i].data()), sent.frames[i].size());
+    }
+
+    return received;
+}
+
+}
+
+int main()
+{
+    const int frames = 100;
+
+    frame_recorder out;
+    connector tx(out);
+    for (int i = 0; i < frames; ++i)
+    {
+        state s = sample(i);
+        tx.send<1>(s);
+    }
+    CHECK(int(out.frames.size()) == frames);
+
+    // Keyframes carry the whole message, deltas only what changed
+    CHECK(out.frames[1].size() < out.frames[0].size());
+    CHECK(out.frames[keyframe_interval].size() == out.frames[0].size());
+
+    std::vector<int> all = deliver(out, 0, -1);
+    CHECK(int(all.size()) == frames);
+    for (int i = 0; i < frames; ++i)
+        CHECK(all[i] == i);
+
+    // Losing frame 25 drops the deltas up to the keyframe at 30
+    std::vector<int> lossy = deliver(out, 0, 25);
+    CHECK(int(lossy.size()) == frames - 5);
+    CHECK(lossy[24] == 24 && lossy[25] == 30);
+
+    // Joining at frame 3 waits for the keyframe at 10
+    std::vector<int> late = deliver(out, 3, -1);
+    CHECK(int(late.size()) == frames - keyframe_interval);
+    CHECK(late[0] == keyframe_interval);
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Every id of a large message set reaches its own handler with its own type
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/message_table.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+// Sizes differ per id, so a frame decoded with another id's size fails
+template <int N>
+struct tagged
+{
+    uint8_t bytes[N % 7 + 1];
+    uint16_t id;
+
+    template <typename P>
+    void method(P& p) { p % bytes; p % id; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 255;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    template <int N>
+    struct data
+    {
+        using type = tagged<N>;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, datatransfer::callback_handler<protocol>>;
+
+int received[protocol::NUMBER_OF_MESSAGES + 1];
+
+template <int N>
+void onTagged(const tagged<N>& m)
+{
+    CHECK(m.id == N && m.bytes[0] == uint8_t(N));
+    ++received[N];
+}
+
+template <int ...N>
+void registerAll(connector& c, datatransfer::message_sequence<N...>)
+{
+    int expand[] = { (c.registerMessageHandler<N>(&onTagged<N>), 0)... };
+    (void)expand;
+}
+
+template <int N>
+int sendTagged(connector& c)
+{
+    tagged<N> m = { { uint8_t(N) }, uint16_t(N) };
+    c.send<N>(m);
+    return 0;
+}
+
+template <int ...N>
+void sendAll(connector& c, datatransfer::message_sequence<N...>)
+{
+    int expand[] = { sendTagged<N>(c)... };
+    (void)expand;
+}
+
+}
+
+int main()
+{
+    using ids = datatransfer::make_message_sequence<1, protocol::NUMBER_OF_MESSAGES>::type;
+
+    std::stringstream out;
+    connector tx(out);
+    sendAll(tx, ids());
+    sendAll(tx, ids());
+    const std::string wire = out.str();
+
+    std::stringstream unused;
+    connector rx(unused);
+    registerAll(rx, ids());
+    rx.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+
+    for (int id = 1; id <= protocol::NUMBER_OF_MESSAGES; ++id)
+        CHECK(received[id] == 2);
+
+    return 0;
+}
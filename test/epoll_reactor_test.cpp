@@ -0,0 +1,183 @@
+// One reactor thread feeds many connectors, drops closed descriptors, and
+// never loses a stop() whether it comes before, during or after run()
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/epoll_reactor.hpp>
+#include <datatransfer/fd_stream.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+using datatransfer::epoll_reactor;
+using datatransfer::fd_stream;
+
+namespace {
+
+struct telemetry
+{
+    uint32_t link;
+    uint32_t sequence;
+
+    template <typename P>
+    void method(P& p) { p % link; p % sequence; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = telemetry;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, fd_stream, protocol, datatransfer::callback_handler<protocol>>;
+
+const int links = 16;
+const uint32_t frames_per_link = 2000;
+
+// The handler has no context, the link travels in the message
+uint32_t next_sequence[links];
+
+void onTelemetry(const telemetry& t)
+{
+    CHECK(t.link < uint32_t(links));
+    CHECK(t.sequence == next_sequence[t.link]);
+    ++next_sequence[t.link];
+}
+
+bool allReceived()
+{
+    for (int i = 0; i < links; ++i)
+    {
+        if (next_sequence[i] != frames_per_link)
+            return false;
+    }
+
+    return true;
+}
+
+void testManyLinks()
+{
+    struct link
+    {
+        int fds[2];
+        std::unique_ptr<fd_stream> tx_stream;
+        std::unique_ptr<fd_stream> rx_stream;
+        std::unique_ptr<connector> tx;
+        std::unique_ptr<connector> rx;
+    };
+
+    epoll_reactor reactor;
+    CHECK(reactor.good());
+
+    std::vector<link> all(links);
+    for (int i = 0; i < links; ++i)
+    {
+        link& l = all[i];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, l.fds) == 0);
+        l.tx_stream.reset(new fd_stream(l.fds[0]));
+        l.rx_stream.reset(new fd_stream(l.fds[1]));
+        l.tx.reset(new connector(*l.tx_stream));
+        l.rx.reset(new connector(*l.rx_stream));
+        l.rx->registerMessageHandler<1>(&onTelemetry);
+
+        // Data sent before add() raises no edge and must still be read
+        if (i % 2 == 0)
+        {
+            telemetry t = { uint32_t(i), 0 };
+            l.tx->send<1>(t);
+        }
+
+        CHECK(reactor.add(l.fds[1], *l.rx));
+    }
+    CHECK(reactor.size() == size_t(links));
+
+    std::thread loop([&reactor]
+    {
+        while (!allReceived())
+            reactor.runOnce(10);
+    });
+
+    for (uint32_t sequence = 0; sequence < frames_per_link; ++sequence)
+    {
+        for (int i = 0; i < links; ++i)
+        {
+            if (sequence == 0 && i % 2 == 0)
+                continue;
+
+            telemetry t = { uint32_t(i), sequence };
+            all[i].tx->send<1>(t);
+        }
+    }
+    loop.join();
+
+    // A closed peer is dropped from the watch list
+    close(all[0].fds[0]);
+    for (int i = 0; i < 100 && reactor.size() == size_t(links); ++i)
+        reactor.runOnce(10);
+    CHECK(reactor.size() == size_t(links - 1));
+
+    for (int i = 0; i < links; ++i)
+    {
+        reactor.remove(all[i].fds[1]);
+        if (i != 0)
+            close(all[i].fds[0]);
+        close(all[i].fds[1]);
+    }
+    CHECK(reactor.size() == 0);
+}
+
+void testStop()
+{
+    epoll_reactor reactor;
+
+    // Issued before run(), kept
+    reactor.stop();
+    reactor.run();
+
+    // Racing with run() starting up
+    std::thread early([&reactor] { reactor.stop(); });
+    reactor.run();
+    early.join();
+
+    // While run() waits
+    std::thread late([&reactor]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        reactor.stop();
+    });
+    reactor.run();
+    late.join();
+}
+
+}
+
+int main()
+{
+    testManyLinks();
+    testStop();
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+// feed() and read() must deliver the same frames however the bytes are split
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+struct sample
+{
+    uint16_t a;
+    uint32_t b;
+
+    template <typename P>
+    void method(P& p) { p % a; p % b; }
+};
+
+template <typename read_char>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<read_char, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+template <typename read_char>
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<read_char>,
+                                              datatransfer::callback_handler<protocol<read_char>>>;
+
+std::vector<uint32_t> received;
+
+void onSample(const sample& s)
+{
+    CHECK(s.a == uint16_t(s.b * 3));
+    received.push_back(s.b);
+}
+
+template <typename read_char>
+std::string sendFrames(int frames)
+{
+    std::stringstream out;
+    connector<read_char> tx(out);
+    for (int i = 0; i < frames; ++i)
+    {
+        sample s = { uint16_t(i * 3), uint32_t(i) };
+        tx.template send<1>(s);
+    }
+
+    return out.str();
+}
+
+void checkReceived(int frames)
+{
+    CHECK(received.size() == size_t(frames));
+    for (int i = 0; i < frames; ++i)
+        CHECK(received[i] == uint32_t(i));
+
+    received.clear();
+}
+
+template <typename read_char>
+void testSplits()
+{
+    const int frames = 200;
+    const std::string wire = sendFrames<read_char>(frames);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(wire.data());
+
+    // Frames split at every possible point across calls
+    std::stringstream unused;
+    connector<read_char> fed(unused);
+    fed.template registerMessageHandler<1>(&onSample);
+    for (size_t offset = 0, chunk = 1; offset < wire.size(); offset += chunk, chunk = chunk % 17 + 1)
+        fed.feed(bytes + offset, std::min(chunk, wire.size() - offset));
+    checkReceived(frames);
+
+    std::stringstream in(wire);
+    connector<read_char> reader(in);
+    reader.template registerMessageHandler<1>(&onSample);
+    reader.read();
+    checkReceived(frames);
+
+    std::stringstream in_bytes(wire);
+    connector<read_char> byte_reader(in_bytes);
+    byte_reader.template registerMessageHandler<1>(&onSample);
+    for (size_t i = 0; i < wire.size(); ++i)
+        byte_reader.readOnce();
+    checkReceived(frames);
+}
+
+}
+
+int main()
+{
+    testSplits<uint8_t>();
+    testSplits<char>();
+
+    return 0;
+}
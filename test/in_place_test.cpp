@@ -0,0 +1,137 @@
+// Bitwise serializable messages are received straight into the parse buffer,
+// and a protocol of only such messages needs no staging buffer to speak of
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+struct samples
+{
+    double t;
+    float v[60];
+
+    template <typename P>
+    void method(P& p) { p % t; p % v; }
+};
+
+struct counter
+{
+    uint32_t n;
+
+    template <typename P>
+    void method(P& p) { p % n; }
+};
+
+}
+
+namespace datatransfer {
+template <> struct is_bitwise_serializable<samples> : std::true_type {};
+template <> struct is_bitwise_serializable<counter> : std::true_type {};
+}
+
+namespace {
+
+template <int staging_size>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 2;
+    static constexpr int MAX_MESSAGE_SIZE = 256;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    template <int N, int = 0>
+    struct data
+    {
+        using type = samples;
+        static const int length = 1;
+    };
+
+    template <int dummy>
+    struct data<2, dummy>
+    {
+        using type = counter;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, staging_size>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+template <int staging_size>
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<staging_size>,
+                                              datatransfer::callback_handler<protocol<staging_size>>>;
+
+int samples_received;
+int counters_received;
+
+void onSamples(const samples& s)
+{
+    CHECK(reinterpret_cast<uintptr_t>(&s) % alignof(samples) == 0);
+    CHECK(s.t == samples_received * 0.5);
+    for (int i = 0; i < 60; ++i)
+        CHECK(s.v[i] == float(samples_received + i));
+    ++samples_received;
+}
+
+void onCounter(const counter& c)
+{
+    CHECK(c.n == uint32_t(counters_received) * 7);
+    ++counters_received;
+}
+
+template <int staging_size>
+void testReceive()
+{
+    const int frames = 50;
+
+    std::stringstream out;
+    connector<staging_size> tx(out);
+    for (int i = 0; i < frames; ++i)
+    {
+        samples s;
+        s.t = i * 0.5;
+        for (int k = 0; k < 60; ++k)
+            s.v[k] = float(i + k);
+        tx.template send<1>(s);
+
+        counter c = { uint32_t(i) * 7 };
+        tx.template send<2>(c);
+    }
+    const std::string wire = out.str();
+
+    samples_received = 0;
+    counters_received = 0;
+
+    std::stringstream in(wire);
+    connector<staging_size> rx(in);
+    rx.template registerMessageHandler<1>(&onSamples);
+    rx.template registerMessageHandler<2>(&onCounter);
+    rx.read();
+
+    CHECK(samples_received == frames);
+    CHECK(counters_received == frames);
+}
+
+}
+
+int main()
+{
+    testReceive<256>();
+
+    // Nothing is staged, the read_policy buffer can shrink to a byte
+    testReceive<1>();
+    static_assert(sizeof(connector<1>) + 200 < sizeof(connector<256>), "Staging buffer did not shrink");
+
+    return 0;
+}
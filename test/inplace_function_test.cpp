@@ -0,0 +1,189 @@
+// inplace_function copies, moves and destroys its callable like
+// std::function but never allocates; inplace_callback_handler dispatches
+// through it
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/inplace_callback_handler.hpp>
+#include <datatransfer/inplace_function.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+size_t allocations;
+
+}
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+using datatransfer::inplace_function;
+
+// Counts live copies, so leaks and double destruction show up
+struct tracked
+{
+    static int alive;
+
+    int offset;
+
+    explicit tracked(int o) : offset(o) { ++alive; }
+    tracked(const tracked& other) : offset(other.offset) { ++alive; }
+    tracked(tracked&& other) : offset(other.offset) { ++alive; }
+    ~tracked() { --alive; }
+
+    int operator()(int x) const { return x + offset; }
+};
+
+int tracked::alive = 0;
+
+int twice(int x)
+{
+    return 2 * x;
+}
+
+void testFunction()
+{
+    {
+        inplace_function<int(int)> empty;
+        CHECK(!empty);
+        CHECK(empty == nullptr);
+
+        inplace_function<int(int)> f = tracked(10);
+        CHECK(f != nullptr);
+        CHECK(f(1) == 11);
+        CHECK(tracked::alive == 1);
+
+        inplace_function<int(int)> copy = f;
+        CHECK(copy(2) == 12 && f(2) == 12);
+        CHECK(tracked::alive == 2);
+
+        inplace_function<int(int)> moved = std::move(copy);
+        CHECK(moved(3) == 13);
+
+        f = &twice;
+        CHECK(f(4) == 8);
+        CHECK(tracked::alive == 2);
+
+        f = moved;
+        CHECK(f(5) == 15);
+
+        moved = nullptr;
+        CHECK(!moved);
+
+        // State captured by value is kept and updated across calls
+        int calls = 0;
+        inplace_function<int()> counter = [calls]() mutable { return ++calls; };
+        counter();
+        CHECK(counter() == 2);
+        CHECK(calls == 0);
+    }
+
+    CHECK(tracked::alive == 0);
+}
+
+struct sample
+{
+    uint32_t value;
+
+    template <typename P>
+    void method(P& p) { p % value; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 2;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    template <int N>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using handler = datatransfer::inplace_callback_handler<protocol>;
+
+void testHandler()
+{
+    handler h;
+    uint64_t first = 0;
+    uint64_t second = 0;
+    sample s = { 3 };
+
+    // Signalling an ID without a handler is a no-op
+    h.signal<1>(s);
+
+    const size_t before = allocations;
+    h.registerHandler<1>([&first](const sample& m) { first += m.value; });
+    h.registerHandler<2>([&first, &second](const sample& m) { second += m.value + first; });
+    h.signal<1>(s);
+    h.signal<2>(s);
+    CHECK(allocations == before);
+    CHECK(first == 3 && second == 6);
+
+    h.deregisterHandler<1>();
+    h.signal<1>(s);
+    CHECK(first == 3);
+}
+
+void testConnector()
+{
+    std::stringstream wire;
+    datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, handler> c(wire);
+
+    uint64_t sum = 0;
+    c.registerMessageHandler<1>([&sum](const sample& m) { sum += m.value; });
+
+    for (uint32_t i = 1; i <= 100; ++i)
+    {
+        sample s = { i };
+        c.send<1>(s);
+    }
+
+    c.read();
+    CHECK(sum == 5050);
+}
+
+}
+
+int main()
+{
+    testFunction();
+    testHandler();
+    testConnector();
+
+    return 0;
+}
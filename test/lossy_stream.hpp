@@ -0,0 +1,59 @@
+#ifndef DATATRANSFER_LOSSY_STREAM_HPP
+#define DATATRANSFER_LOSSY_STREAM_HPP
+
+#include <cstddef>
+#include <random>
+#include <stdint.h>
+
+// Wraps another stream and drops whole write() calls at random, the way a
+// lossy link drops packets. p2p_connector hands whole frames to write(), so
+// the peer sees frames go missing but never one cut short. Writes are
+// serialized by the connector's send mutex; reads are passed straight
+// through.
+template <typename stream>
+class lossy_stream
+{
+public:
+    using char_type = typename stream::char_type;
+
+    lossy_stream(stream& s, double loss, uint32_t seed)
+        : _stream(s)
+        , _loss(loss)
+        , _random(seed)
+        , _dropped(0)
+    {}
+
+    bool good() const { return _stream.good(); }
+    bool eof() const { return _stream.eof(); }
+    void clear() { _stream.clear(); }
+
+    size_t readsome(char_type* buf, size_t n) { return _stream.readsome(buf, n); }
+    int get() { return _stream.get(); }
+
+    lossy_stream& write(const char_type* buf, size_t n)
+    {
+        if (std::uniform_real_distribution<double>(0.0, 1.0)(_random) < _loss)
+            ++_dropped;
+        else
+            _stream.write(buf, n);
+
+        return *this;
+    }
+
+    lossy_stream& flush()
+    {
+        _stream.flush();
+        return *this;
+    }
+
+    // Number of writes dropped so far
+    size_t dropped() const { return _dropped; }
+
+private:
+    stream& _stream;
+    double _loss;
+    std::mt19937 _random;
+    size_t _dropped;
+};
+
+#endif // DATATRANSFER_LOSSY_STREAM_HPP
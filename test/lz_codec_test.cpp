@@ -0,0 +1,202 @@
+// lz_codec round trips, refuses malformed input and small output buffers,
+// and frames above COMPRESSION_THRESHOLD travel compressed when that helps
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/lz_codec.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/packet_types.h>
+#include "test_support.hpp"
+
+namespace {
+
+using codec = datatransfer::lz_codec<>;
+
+// Worst case: every byte a literal, plus a length byte per 255 of them
+size_t bound(size_t n)
+{
+    return n + n / 255 + 16;
+}
+
+void roundTrip(const std::vector<uint8_t>& in)
+{
+    std::vector<uint8_t> packed(bound(in.size()));
+    const size_t packed_size = codec::compress(in.data(), in.size(), packed.data(), packed.size());
+    CHECK(packed_size > 0 || in.empty());
+
+    std::vector<uint8_t> out(in.size() + 1);
+    CHECK(codec::decompress(packed.data(), packed_size, out.data(), out.size()) == in.size());
+    CHECK(std::equal(in.begin(), in.end(), out.begin()));
+
+    // One byte short of the output
+    if (!in.empty())
+        CHECK(codec::decompress(packed.data(), packed_size, out.data(), in.size() - 1) == 0);
+}
+
+void testRoundTrips()
+{
+    std::mt19937 random(3);
+
+    roundTrip({});
+    roundTrip({ 1, 2, 3 });
+
+    std::vector<uint8_t> noise(5000);
+    for (auto& byte : noise)
+        byte = uint8_t(random());
+    roundTrip(noise);
+
+    // Runs long enough to need extra length bytes, and overlapping matches
+    std::vector<uint8_t> runs(codec::MAX_INPUT_SIZE, 0x42);
+    for (size_t i = 0; i < runs.size(); i += 1000)
+        runs[i] = uint8_t(i);
+    roundTrip(runs);
+
+    std::vector<uint8_t> records;
+    for (uint32_t i = 0; i < 500; ++i)
+    {
+        const uint8_t record[] = { 0x10, 0x20, uint8_t(i), uint8_t(i >> 8), 0, 0, 0x7F, 0x3F };
+        records.insert(records.end(), record, record + sizeof(record));
+    }
+    roundTrip(records);
+
+    // Records differing in two bytes out of eight still shrink
+    std::vector<uint8_t> packed(bound(records.size()));
+    CHECK(codec::compress(records.data(), records.size(), packed.data(), packed.size()) < records.size() * 3 / 4);
+
+    // Too large to encode 16 bit offsets safely, or no room for the result
+    std::vector<uint8_t> large(codec::MAX_INPUT_SIZE + 1);
+    std::vector<uint8_t> large_out(bound(large.size()));
+    CHECK(codec::compress(large.data(), large.size(), large_out.data(), large_out.size()) == 0);
+    CHECK(codec::compress(noise.data(), noise.size(), packed.data(), noise.size() / 2) == 0);
+}
+
+void testMalformed()
+{
+    uint8_t out[64];
+
+    // Match offset before the start of the output
+    const uint8_t bad_offset[] = { 0x10, 'a', 0x05, 0x00 };
+    CHECK(codec::decompress(bad_offset, sizeof(bad_offset), out, sizeof(out)) == 0);
+
+    // Zero offset
+    const uint8_t zero_offset[] = { 0x10, 'a', 0x00, 0x00 };
+    CHECK(codec::decompress(zero_offset, sizeof(zero_offset), out, sizeof(out)) == 0);
+
+    // More literals announced than present
+    const uint8_t short_literals[] = { 0x50, 'a', 'b' };
+    CHECK(codec::decompress(short_literals, sizeof(short_literals), out, sizeof(out)) == 0);
+
+    // Truncated offset and truncated length bytes
+    const uint8_t short_offset[] = { 0x10, 'a', 0x01 };
+    CHECK(codec::decompress(short_offset, sizeof(short_offset), out, sizeof(out)) == 0);
+    const uint8_t short_length[] = { 0xF0, 0xFF };
+    CHECK(codec::decompress(short_length, sizeof(short_length), out, sizeof(out)) == 0);
+
+    // Random garbage never writes past the output
+    std::mt19937 random(4);
+    for (int i = 0; i < 10000; ++i)
+    {
+        uint8_t garbage[32];
+        for (auto& byte : garbage)
+            byte = uint8_t(random());
+        CHECK(codec::decompress(garbage, sizeof(garbage), out, sizeof(out)) <= sizeof(out));
+    }
+}
+
+struct blob
+{
+    uint8_t bytes[200];
+
+    template <typename P>
+    void method(P& p) { p % bytes; }
+};
+
+template <size_t threshold>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 256;
+    static constexpr size_t COMPRESSION_THRESHOLD = threshold;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    using header_type = datatransfer::length_packet_header;
+
+    template <int N>
+    struct data
+    {
+        using type = blob;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::crc16_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+template <size_t threshold>
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<threshold>,
+                                              datatransfer::callback_handler<protocol<threshold>>>;
+
+std::vector<blob> received;
+
+void onBlob(const blob& b)
+{
+    received.push_back(b);
+}
+
+template <size_t threshold>
+size_t wireSize(blob& b)
+{
+    std::stringstream wire;
+    connector<threshold> c(wire);
+    c.template registerMessageHandler<1>(&onBlob);
+    c.template send<1>(b);
+
+    const size_t size = wire.str().size();
+    c.read();
+    return size;
+}
+
+void testConnector()
+{
+    blob repetitive;
+    for (size_t i = 0; i < sizeof(repetitive.bytes); ++i)
+        repetitive.bytes[i] = uint8_t(i % 8);
+
+    blob noise;
+    std::mt19937 random(5);
+    for (auto& byte : noise.bytes)
+        byte = uint8_t(random());
+
+    const size_t plain = wireSize<0>(repetitive);
+    CHECK(wireSize<64>(repetitive) < plain / 2);
+
+    // Not worth compressing, so it goes out as is
+    CHECK(wireSize<64>(noise) == plain);
+
+    CHECK(received.size() == 3);
+    CHECK(std::equal(repetitive.bytes, repetitive.bytes + sizeof(repetitive.bytes), received[1].bytes));
+    CHECK(std::equal(noise.bytes, noise.bytes + sizeof(noise.bytes), received[2].bytes));
+}
+
+}
+
+int main()
+{
+    testRoundTrips();
+    testMalformed();
+    testConnector();
+
+    return 0;
+}
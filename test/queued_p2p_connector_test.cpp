@@ -0,0 +1,196 @@
+// queued_p2p_connector with two priority levels and fragmentation: bulk
+// frames are rebuilt intact and in order, and an urgent frame queued while
+// a bulk frame is going out waits for at most one fragment
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/packet_types.h>
+#include <datatransfer/queued_p2p_connector.hpp>
+#include <datatransfer/std_function_callback_handler.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+struct bulk
+{
+    uint8_t bytes[1000];
+
+    template <typename P>
+    void method(P& p) { p % bytes; }
+};
+
+struct command
+{
+    uint64_t stamp;
+
+    template <typename P>
+    void method(P& p) { p % stamp; }
+};
+
+// 1: bulk at level 0, 2: command at level 1
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 2;
+    static constexpr int MAX_MESSAGE_SIZE = 1000;
+    static constexpr int PRIORITY_LEVELS = 2;
+    static constexpr size_t FRAGMENT_SIZE = 64;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    using header_type = datatransfer::length_packet_header;
+
+    template <int N, int = 0>
+    struct data
+    {
+        using type = bulk;
+        static const int length = 1;
+    };
+
+    template <int dummy>
+    struct data<2, dummy>
+    {
+        using type = command;
+        static const int length = 1;
+        static const int priority = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::crc16_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+// Counts the bytes written and hands them to on_write straight away
+struct link
+{
+    using char_type = char;
+
+    uint64_t clock = 0;
+    size_t writes = 0;
+    std::function<void(const char*, size_t)> on_write;
+
+    bool good() const { return true; }
+    int get() { return -1; }
+
+    link& write(const char_type* data, size_t n)
+    {
+        clock += n;
+        ++writes;
+        if (on_write)
+            on_write(data, n);
+        return *this;
+    }
+
+    link& flush() { return *this; }
+};
+
+using handler = datatransfer::std_function_callback_handler<protocol>;
+using sender = datatransfer::queued_p2p_connector<std::mutex, link, protocol, handler, 16>;
+using receiver = datatransfer::p2p_connector<std::mutex, link, protocol, handler>;
+
+bulk makeBulk(uint8_t seed)
+{
+    bulk b;
+    for (size_t i = 0; i < sizeof(b.bytes); ++i)
+        b.bytes[i] = uint8_t(seed + i * 7);
+
+    return b;
+}
+
+void flushAll(sender& tx)
+{
+    while (tx.pending() > 0)
+        tx.flushPending();
+}
+
+void testReassembly()
+{
+    link wire;
+    link unused;
+    sender tx(wire);
+    receiver rx(unused);
+    wire.on_write = [&rx](const char* data, size_t n) { rx.feed(reinterpret_cast<const uint8_t*>(data), n); };
+
+    std::vector<uint8_t> received;
+    rx.registerMessageHandler<1>([&received](const bulk& b)
+    {
+        const bulk expected = makeBulk(b.bytes[0]);
+        CHECK(std::equal(b.bytes, b.bytes + sizeof(b.bytes), expected.bytes));
+        received.push_back(b.bytes[0]);
+    });
+
+    for (uint8_t seed = 0; seed < 5; ++seed)
+    {
+        bulk b = makeBulk(seed);
+        tx.send<1>(b);
+    }
+    CHECK(tx.pending() == 5);
+
+    flushAll(tx);
+    CHECK(received.size() == 5);
+    for (uint8_t seed = 0; seed < 5; ++seed)
+        CHECK(received[seed] == seed);
+
+    // Each fragment reached the stream on its own
+    CHECK(wire.writes >= 5 * (sizeof(bulk) / protocol::FRAGMENT_SIZE));
+}
+
+void testUrgentFrame()
+{
+    link wire;
+    link unused;
+    sender tx(wire);
+    receiver rx(unused);
+
+    std::vector<int> order;
+    uint64_t delay = 0;
+    bool queued = false;
+    rx.registerMessageHandler<1>([&order](const bulk&) { order.push_back(1); });
+    rx.registerMessageHandler<2>([&](const command& c)
+    {
+        order.push_back(2);
+        delay = wire.clock - c.stamp;
+    });
+
+    // The command is queued once the first fragment has gone out
+    wire.on_write = [&](const char* data, size_t n)
+    {
+        rx.feed(reinterpret_cast<const uint8_t*>(data), n);
+        if (!queued)
+        {
+            queued = true;
+            command c = { wire.clock };
+            tx.send<2>(c);
+        }
+    };
+
+    for (uint8_t seed = 0; seed < 3; ++seed)
+    {
+        bulk b = makeBulk(seed);
+        tx.send<1>(b);
+    }
+
+    flushAll(tx);
+    CHECK(order.size() == 4);
+    CHECK(order[0] == 2);
+
+    // One fragment frame and the command frame itself
+    CHECK(delay > 0 && delay < 2 * protocol::FRAGMENT_SIZE + 64);
+}
+
+}
+
+int main()
+{
+    testReassembly();
+    testUrgentFrame();
+
+    return 0;
+}
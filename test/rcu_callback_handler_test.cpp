@@ -0,0 +1,151 @@
+// rcu_callback_handler: several subscribers per ID, removal by handle or all
+// at once, and subscribe/unsubscribe racing a signalling thread
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/rcu_callback_handler.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+struct sample
+{
+    uint32_t value;
+
+    template <typename P>
+    void method(P& p) { p % value; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 2;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    template <int N>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using handler = datatransfer::rcu_callback_handler<protocol>;
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, handler>;
+
+void testSubscribers()
+{
+    handler h;
+    std::vector<int> calls(4, 0);
+    sample s = { 5 };
+
+    // Nobody subscribed yet
+    h.signal<1>(s);
+
+    const handler::subscription first = h.registerHandler<1>([&calls](const sample& m) { calls[0] += m.value; });
+    const handler::subscription second = h.registerHandler<1>([&calls](const sample& m) { calls[1] += m.value; });
+    h.registerHandler<1>([&calls](const sample& m) { calls[2] += m.value; });
+    h.registerHandler<2>([&calls](const sample& m) { calls[3] += m.value; });
+    CHECK(first != second);
+
+    h.signal<1>(s);
+    CHECK(calls[0] == 5 && calls[1] == 5 && calls[2] == 5 && calls[3] == 0);
+
+    h.deregisterHandler<1>(second);
+    h.signal<1>(s);
+    CHECK(calls[0] == 10 && calls[1] == 5 && calls[2] == 10);
+
+    // Unknown and already removed handles are ignored
+    h.deregisterHandler<1>(second);
+    h.deregisterHandler<1>(handler::subscription(12345));
+    h.signal<1>(s);
+    CHECK(calls[0] == 15 && calls[1] == 5 && calls[2] == 15);
+
+    h.deregisterHandler<1>();
+    h.signal<1>(s);
+    h.signal<2>(s);
+    CHECK(calls[0] == 15 && calls[2] == 15 && calls[3] == 5);
+}
+
+void testConnector()
+{
+    std::stringstream wire;
+    connector c(wire);
+
+    int first = 0;
+    int second = 0;
+    const handler::subscription id = c.registerMessageHandler<1>([&first](const sample& m) { first += m.value; });
+    c.registerMessageHandler<1>([&second](const sample& m) { second += m.value; });
+
+    sample s = { 1 };
+    c.send<1>(s);
+    c.read();
+    CHECK(first == 1 && second == 1);
+
+    c.deregisterMessageHandler<1>(id);
+    wire.clear();
+    c.send<1>(s);
+    c.read();
+    CHECK(first == 1 && second == 2);
+}
+
+// Each signal must reach the permanent subscriber exactly once while the
+// list is replaced under it
+void testConcurrentUpdates()
+{
+    handler h;
+    std::atomic<uint64_t> permanent(0);
+    std::atomic<uint64_t> transient(0);
+    std::atomic<bool> done(false);
+
+    h.registerHandler<1>([&permanent](const sample&) { permanent.fetch_add(1, std::memory_order_relaxed); });
+
+    uint64_t signals = 0;
+    std::thread reader([&]
+    {
+        sample s = { 0 };
+        while (!done.load(std::memory_order_acquire))
+        {
+            h.signal<1>(s);
+            ++signals;
+        }
+    });
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        const handler::subscription id =
+            h.registerHandler<1>([&transient](const sample&) { transient.fetch_add(1, std::memory_order_relaxed); });
+        h.deregisterHandler<1>(id);
+    }
+
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    CHECK(permanent.load() == signals);
+    CHECK(transient.load() <= signals);
+}
+
+}
+
+int main()
+{
+    testSubscribers();
+    testConnector();
+    testConcurrentUpdates();
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+// Reliable messages over a local socket pair that drops a fifth of all
+// writes in each direction arrive complete and in order; a full window
+// makes send() give up after SEND_TIMEOUT_MS; a restarted sender is
+// recognised by its new epoch
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/fd_stream.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/packet_types.h>
+#include <datatransfer/std_function_callback_handler.hpp>
+#include "lossy_stream.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+struct sample
+{
+    uint32_t sequence;
+    uint32_t check;
+
+    template <typename P>
+    void method(P& p) { p % sequence; p % check; }
+};
+
+// 1: reliable, 2: best effort
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 2;
+    static constexpr int MAX_MESSAGE_SIZE = 64;
+    static constexpr size_t RELIABLE_WINDOW = 16;
+    static constexpr int RETRANSMIT_TIMEOUT_MS = 5;
+    static constexpr int SEND_TIMEOUT_MS = 100;
+    static constexpr bool valid(int id) { return id >= 1 && id <= NUMBER_OF_MESSAGES; }
+
+    using header_type = datatransfer::length_packet_header;
+
+    template <int N, int = 0>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+        static const bool reliable = true;
+    };
+
+    template <int dummy>
+    struct data<2, dummy>
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::crc16_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+using handler = datatransfer::std_function_callback_handler<protocol>;
+using lossy_fd_stream = lossy_stream<datatransfer::fd_stream>;
+using lossy_connector = datatransfer::p2p_connector<std::mutex, lossy_fd_stream, protocol, handler>;
+using string_connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, handler>;
+
+sample makeSample(uint32_t sequence)
+{
+    return sample{ sequence, sequence * 7 + 1 };
+}
+
+void testLossyLink()
+{
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    datatransfer::fd_stream a(fds[0]);
+    datatransfer::fd_stream b(fds[1]);
+    lossy_fd_stream lossy_a(a, 0.2, 1);
+    lossy_fd_stream lossy_b(b, 0.2, 2);
+    lossy_connector sender(lossy_a);
+    lossy_connector receiver(lossy_b);
+
+    std::vector<uint32_t> reliable;
+    size_t best_effort = 0;
+    receiver.registerMessageHandler<1>([&reliable](const sample& s)
+    {
+        CHECK(s.check == makeSample(s.sequence).check);
+        reliable.push_back(s.sequence);
+    });
+    receiver.registerMessageHandler<2>([&best_effort](const sample&) { ++best_effort; });
+
+    // The sender needs a reader too, acknowledgements only arrive through it
+    std::thread sender_reader([&sender] { sender.read(); });
+    std::thread receiver_reader([&receiver] { receiver.read(); });
+
+    const uint32_t frames = 2000;
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        sample s = makeSample(i);
+        while (!sender.send<1>(s)) {}
+
+        if (i % 4 == 0)
+            sender.send<2>(s);
+    }
+
+    // Frames and acknowledgements lost at the end are only resent on request
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (sender.unacknowledged() > 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        sender.retransmit();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(sender.unacknowledged() == 0);
+
+    // Ends both read() loops
+    shutdown(fds[0], SHUT_RDWR);
+    shutdown(fds[1], SHUT_RDWR);
+    sender_reader.join();
+    receiver_reader.join();
+
+    CHECK(lossy_a.dropped() > 0 && lossy_b.dropped() > 0);
+    CHECK(reliable.size() == frames);
+    for (uint32_t i = 0; i < frames; ++i)
+        CHECK(reliable[i] == i);
+    CHECK(best_effort < frames / 4);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// Nobody acknowledges, so the window fills up
+void testSendTimeout()
+{
+    std::stringstream wire;
+    string_connector c(wire);
+
+    sample s = makeSample(1);
+    for (size_t i = 0; i < protocol::RELIABLE_WINDOW; ++i)
+        CHECK(c.send<1>(s));
+
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(!c.send<1>(s));
+    const auto waited = std::chrono::steady_clock::now() - start;
+    const int timeout_ms = protocol::SEND_TIMEOUT_MS;
+    CHECK(waited >= std::chrono::milliseconds(timeout_ms));
+    CHECK(waited < std::chrono::milliseconds(10 * timeout_ms));
+    CHECK(c.unacknowledged() == protocol::RELIABLE_WINDOW);
+}
+
+// A new sender starts over at sequence number 0 with another epoch
+void testPeerRestart()
+{
+    std::stringstream wire;
+    string_connector receiver(wire);
+
+    std::vector<uint32_t> received;
+    receiver.registerMessageHandler<1>([&received](const sample& s) { received.push_back(s.sequence); });
+
+    {
+        string_connector sender(wire);
+        for (uint32_t i = 0; i < 5; ++i)
+        {
+            sample s = makeSample(i);
+            CHECK(sender.send<1>(s));
+        }
+    }
+
+    receiver.read();
+    CHECK(received.size() == 5);
+    wire.clear();
+
+    // Epochs come from the clock
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    {
+        string_connector sender(wire);
+        for (uint32_t i = 10; i < 13; ++i)
+        {
+            sample s = makeSample(i);
+            CHECK(sender.send<1>(s));
+        }
+    }
+
+    receiver.read();
+    CHECK(received.size() == 8);
+    CHECK(received[5] == 10 && received[6] == 11 && received[7] == 12);
+}
+
+}
+
+int main()
+{
+    // Acknowledgements may still be written after the socket is shut down
+    signal(SIGPIPE, SIG_IGN);
+
+    testLossyLink();
+    testSendTimeout();
+    testPeerRestart();
+
+    return 0;
+}
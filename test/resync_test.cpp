@@ -0,0 +1,130 @@
+// After a false sync the parser resumes right after the false SYNC_1, so a
+// real frame hidden in the bytes of a rejected one is still delivered,
+// however the input is split into chunks
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/packet_types.h>
+#include "test_support.hpp"
+
+namespace {
+
+struct sample
+{
+    uint32_t value;
+    uint8_t fill[8];
+
+    template <typename P>
+    void method(P& p) { p % value; p % fill; }
+};
+
+template <typename header>
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 32;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    using header_type = header;
+
+    template <int N>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::crc16_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+template <typename header>
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol<header>,
+                                              datatransfer::callback_handler<protocol<header>>>;
+
+std::vector<uint32_t> received;
+
+void onSample(const sample& s)
+{
+    received.push_back(s.value);
+}
+
+template <typename header>
+std::string frame(uint32_t value)
+{
+    std::stringstream out;
+    connector<header> tx(out);
+    sample s = { value, { 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA } };
+    tx.template send<1>(s);
+
+    return out.str();
+}
+
+// Feeds wire in chunks of every size and expects exactly the given values
+template <typename header>
+void checkDelivered(const std::string& wire, const std::vector<uint32_t>& values)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(wire.data());
+
+    for (size_t chunk = 1; chunk <= wire.size(); ++chunk)
+    {
+        std::stringstream unused;
+        connector<header> rx(unused);
+        rx.template registerMessageHandler<1>(&onSample);
+
+        for (size_t offset = 0; offset < wire.size(); offset += chunk)
+            rx.feed(bytes + offset, std::min(chunk, wire.size() - offset));
+
+        CHECK(received == values);
+        received.clear();
+    }
+}
+
+template <typename header>
+void testFalseSyncs()
+{
+    const std::string first = frame<header>(1);
+    const std::string second = frame<header>(2);
+
+    // SYNC_1 SYNC_1 SYNC_2
+    checkDelivered<header>("\x55" + first + second, { 1, 2 });
+
+    // A false frame start swallowing the beginning of a real frame
+    checkDelivered<header>(std::string("\x55\xAA\x01", 3) + first + second, { 1, 2 });
+    checkDelivered<header>(first + std::string("\x55\xAA\x01\x00", 4) + second, { 1, 2 });
+
+    // A real frame cut short, then the next one
+    checkDelivered<header>(first.substr(0, first.size() - 3) + second, { 2 });
+}
+
+// A length the receiver cannot take is a false sync, not a frame to skip
+void testImplausibleLength()
+{
+    using header = datatransfer::length_packet_header;
+
+    const std::string wire = std::string("\x55\xAA\x01\xFF\xFF", 5) + frame<header>(7) + frame<header>(8);
+    checkDelivered<header>(wire, { 7, 8 });
+}
+
+}
+
+int main()
+{
+    testFalseSyncs<datatransfer::packet_header>();
+    testFalseSyncs<datatransfer::length_packet_header>();
+    testImplausibleLength();
+
+    return 0;
+}
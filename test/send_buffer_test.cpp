@@ -0,0 +1,132 @@
+// send() hands each frame to the stream in one write, a batch packs frames
+// into as few writes as the TX buffer allows and flushes once
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include "test_support.hpp"
+
+namespace {
+
+// Records the bytes and counts the calls
+struct counting_stream
+{
+    using char_type = char;
+
+    std::string bytes;
+    size_t writes = 0;
+    size_t flushes = 0;
+
+    bool good() const { return true; }
+    int get() { return -1; }
+
+    counting_stream& write(const char_type* data, size_t n)
+    {
+        bytes.append(data, n);
+        ++writes;
+        return *this;
+    }
+
+    counting_stream& flush()
+    {
+        ++flushes;
+        return *this;
+    }
+};
+
+struct telemetry
+{
+    uint32_t id;
+    uint16_t value;
+    uint8_t flags;
+
+    template <typename P>
+    void method(P& p) { p % id; p % value; p % flags; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 16;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = telemetry;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+const size_t tx_buffer_size = 64;
+
+using connector = datatransfer::p2p_connector<std::mutex, counting_stream, protocol,
+                                              datatransfer::callback_handler<protocol>, tx_buffer_size>;
+
+uint32_t received;
+
+void onTelemetry(const telemetry& t)
+{
+    CHECK(t.id == received && t.value == uint16_t(received * 3) && t.flags == uint8_t(received));
+    ++received;
+}
+
+telemetry sample(uint32_t i)
+{
+    telemetry t = { i, uint16_t(i * 3), uint8_t(i) };
+    return t;
+}
+
+}
+
+int main()
+{
+    const uint32_t frames = 100;
+
+    counting_stream out;
+    connector tx(out);
+
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        telemetry t = sample(i);
+        tx.send<1>(t);
+    }
+    CHECK(out.writes == frames);
+    CHECK(out.flushes == frames);
+
+    const size_t frame_size = out.bytes.size() / frames;
+    const size_t frames_per_write = tx_buffer_size / frame_size;
+
+    out.writes = 0;
+    out.flushes = 0;
+    {
+        auto batch = tx.beginBatch();
+        for (uint32_t i = frames; i < 2 * frames; ++i)
+        {
+            telemetry t = sample(i);
+            batch.send<1>(t);
+        }
+    }
+    CHECK(out.writes == (frames + frames_per_write - 1) / frames_per_write);
+    CHECK(out.flushes == 1);
+
+    counting_stream unused;
+    connector rx(unused);
+    rx.registerMessageHandler<1>(&onTelemetry);
+    rx.feed(reinterpret_cast<const uint8_t*>(out.bytes.data()), out.bytes.size());
+    CHECK(received == 2 * frames);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+// The shared memory ring moves bytes intact across wrap-arounds, and
+// shm_stream carries frames between two ends until one of them closes
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <datatransfer/binary_serialization.hpp>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/shm_stream.hpp>
+#include "test_support.hpp"
+
+using datatransfer::shm_stream;
+using datatransfer::spsc_ring;
+
+namespace {
+
+struct sample
+{
+    uint64_t sequence;
+    uint8_t pad[24];
+
+    template <typename P>
+    void method(P& p) { p % sequence; p % pad; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 64;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    template <int N>
+    struct data
+    {
+        using type = sample;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::binary_serialization::write_policy<io>;
+        using read_policy = datatransfer::binary_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::binary_serialization::checksum_policy;
+        using size_policy = datatransfer::binary_serialization::size_policy;
+    };
+};
+
+// Small rings so frames straddle the wrap-around
+const size_t ring_size = 4096;
+
+using stream = shm_stream<ring_size>;
+using connector = datatransfer::p2p_connector<std::mutex, stream, protocol, datatransfer::callback_handler<protocol>>;
+
+uint64_t received;
+
+void onSample(const sample& s)
+{
+    CHECK(s.sequence == received);
+    CHECK(s.pad[0] == uint8_t(received) && s.pad[23] == uint8_t(~received));
+    ++received;
+}
+
+void testRing()
+{
+    const size_t bytes = 1 << 20;
+
+    std::unique_ptr<spsc_ring<64>> ring(new spsc_ring<64>());
+    std::vector<char> sent(bytes);
+    for (size_t i = 0; i < bytes; ++i)
+        sent[i] = char(i * 131 + i / 256);
+
+    std::thread writer([&]
+    {
+        size_t chunk = 1;
+        for (size_t offset = 0; offset < bytes; chunk = chunk % 97 + 1)
+        {
+            const size_t n = ring->write(sent.data() + offset, std::min(chunk, bytes - offset));
+            offset += n;
+            if (n == 0)
+                ring->waitWritable();
+        }
+    });
+
+    std::vector<char> read(bytes);
+    size_t chunk = 1;
+    for (size_t offset = 0; offset < bytes; chunk = chunk % 89 + 1)
+    {
+        const size_t n = ring->read(read.data() + offset, std::min(chunk, bytes - offset));
+        offset += n;
+        if (n == 0)
+            ring->waitReadable();
+    }
+    writer.join();
+
+    CHECK(read == sent);
+    CHECK(ring->empty());
+}
+
+void testStream(const std::string& name)
+{
+    const uint64_t frames = 100000;
+
+    std::unique_ptr<stream> creator(new stream(name.c_str(), stream::CREATE));
+    stream opener(name.c_str(), stream::OPEN);
+    CHECK(creator->good() && opener.good());
+
+    connector rx(opener);
+    rx.registerMessageHandler<1>(&onSample);
+
+    // read() returns once the other end has gone and the ring is drained
+    std::thread reader([&rx] { rx.read(); });
+
+    {
+        connector tx(*creator);
+        for (uint64_t i = 0; i < frames; ++i)
+        {
+            sample s = {};
+            s.sequence = i;
+            s.pad[0] = uint8_t(i);
+            s.pad[23] = uint8_t(~i);
+            tx.send<1>(s);
+        }
+    }
+    creator.reset();
+    reader.join();
+
+    CHECK(received == frames);
+    CHECK(opener.eof());
+}
+
+void testOpenFailures(const std::string& name)
+{
+    stream missing(name.c_str(), stream::OPEN);
+    CHECK(!missing.good());
+
+    stream creator(name.c_str(), stream::CREATE);
+    CHECK(creator.good());
+
+    // A segment laid out for another ring size is refused
+    shm_stream<ring_size / 2> mismatched(name.c_str(), shm_stream<ring_size / 2>::OPEN);
+    CHECK(!mismatched.good());
+}
+
+}
+
+int main()
+{
+    const std::string name = "/datatransfer_test_" + std::to_string(getpid());
+
+    testRing();
+    testStream(name);
+    testOpenFailures(name);
+
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef DATATRANSFER_TEST_SUPPORT_HPP
+#define DATATRANSFER_TEST_SUPPORT_HPP
+
+#include <cstdio>
+#include <cstdlib>
+
+// Unlike assert() also checked in release builds
+#define CHECK(condition)                                                          \
+    do                                                                            \
+    {                                                                             \
+        if (!(condition))                                                         \
+        {                                                                         \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                         #condition);                                             \
+            std::exit(1);                                                         \
+        }                                                                         \
+    } while (false)
+
+#endif // DATATRANSFER_TEST_SUPPORT_HPP
@@ -0,0 +1,179 @@
+// LEB128/zigzag encoding at the edges of every width, both decode paths,
+// and varint_serialization frames through a connector
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <datatransfer/callback_handler.hpp>
+#include <datatransfer/p2p_connector.hpp>
+#include <datatransfer/packet_types.h>
+#include <datatransfer/varint.hpp>
+#include <datatransfer/varint_serialization.hpp>
+#include "test_support.hpp"
+
+using datatransfer::leb128;
+
+namespace {
+
+struct status
+{
+    uint32_t counter;
+    int32_t dx;
+    int64_t offset;
+    uint64_t uptime_ms;
+    uint16_t flags;
+    int16_t trim;
+    uint8_t mode;
+
+    template <typename P>
+    void method(P& p) { p % counter; p % dx; p % offset; p % uptime_ms; p % flags; p % trim; p % mode; }
+};
+
+struct protocol
+{
+    static constexpr int NUMBER_OF_MESSAGES = 1;
+    static constexpr int MAX_MESSAGE_SIZE = 64;
+    static constexpr bool valid(int id) { return id == 1; }
+
+    using header_type = datatransfer::length_packet_header;
+
+    template <int N>
+    struct data
+    {
+        using type = status;
+        static const int length = 1;
+    };
+
+    template <typename io>
+    struct serialization
+    {
+        using write_policy = datatransfer::varint_serialization::write_policy<io>;
+        using read_policy = datatransfer::varint_serialization::read_policy<uint8_t, MAX_MESSAGE_SIZE>;
+        using checksum_policy = datatransfer::varint_serialization::crc16_policy;
+        using size_policy = datatransfer::varint_serialization::size_policy;
+    };
+};
+
+using connector = datatransfer::p2p_connector<std::mutex, std::stringstream, protocol, datatransfer::callback_handler<protocol>>;
+
+// Round trips v with the fast decode path (padding after the value) and
+// the byte at a time one (nothing after it)
+template <typename T>
+void checkRoundTrip(T t)
+{
+    const uint64_t v = leb128::encode_value(t);
+
+    uint8_t padded[leb128::MAX_SIZE + 8] = {};
+    const size_t size = leb128::encode(v, padded);
+    CHECK(size == leb128::encoded_size(v));
+    CHECK(size <= leb128::MAX_SIZE);
+
+    uint64_t decoded = 0;
+    CHECK(leb128::decode(padded, sizeof(padded), decoded) == size);
+    CHECK(leb128::decode_value<T>(decoded) == t);
+
+    uint8_t exact[leb128::MAX_SIZE];
+    leb128::encode(v, exact);
+    CHECK(leb128::decode(exact, size, decoded) == size);
+    CHECK(leb128::decode_value<T>(decoded) == t);
+
+    // Truncated input is reported, not read past
+    CHECK(leb128::decode(exact, size - 1, decoded) == 0);
+}
+
+template <typename T>
+void checkWidth()
+{
+    const T low = std::numeric_limits<T>::min();
+    const T high = std::numeric_limits<T>::max();
+
+    checkRoundTrip<T>(0);
+    checkRoundTrip<T>(1);
+    checkRoundTrip<T>(low);
+    checkRoundTrip<T>(high);
+    checkRoundTrip<T>(T(low + 1));
+    checkRoundTrip<T>(T(high - 1));
+
+    // Every 7 bit group boundary that fits the type
+    for (unsigned bits = 6; bits < sizeof(T) * 8 - 1; bits += 7)
+    {
+        checkRoundTrip<T>(T((uint64_t(1) << bits) - 1));
+        checkRoundTrip<T>(T(uint64_t(1) << bits));
+    }
+}
+
+void testEncoding()
+{
+    checkWidth<uint16_t>();
+    checkWidth<int16_t>();
+    checkWidth<uint32_t>();
+    checkWidth<int32_t>();
+    checkWidth<uint64_t>();
+    checkWidth<int64_t>();
+
+    // Zigzag keeps small negative values small
+    CHECK(leb128::encode_value<int32_t>(-1) == 1);
+    CHECK(leb128::encode_value<int32_t>(-64) == 127);
+    CHECK(leb128::encoded_size(leb128::encode_value<int64_t>(-64)) == 1);
+
+    // More continuation bytes than any 64 bit value needs
+    uint8_t overlong[16];
+    for (size_t i = 0; i < sizeof(overlong); ++i)
+        overlong[i] = 0x80;
+    uint64_t v;
+    CHECK(leb128::decode(overlong, sizeof(overlong), v) == 0);
+}
+
+status sample(int i)
+{
+    status s;
+    s.counter = uint32_t(i);
+    s.dx = i % 2 ? -i : i;
+    s.offset = i == 3 ? std::numeric_limits<int64_t>::min() : -int64_t(i) * 1000000007;
+    s.uptime_ms = i == 4 ? std::numeric_limits<uint64_t>::max() : 3600000ull + i * 10;
+    s.flags = uint16_t(i * 4099);
+    s.trim = int16_t(-i * 300);
+    s.mode = uint8_t(i);
+    return s;
+}
+
+int received;
+
+void onStatus(const status& s)
+{
+    const status expected = sample(received++);
+    CHECK(s.counter == expected.counter && s.dx == expected.dx && s.offset == expected.offset);
+    CHECK(s.uptime_ms == expected.uptime_ms && s.flags == expected.flags && s.trim == expected.trim);
+    CHECK(s.mode == expected.mode);
+}
+
+void testConnector()
+{
+    const int frames = 100;
+
+    std::stringstream out;
+    connector tx(out);
+    for (int i = 0; i < frames; ++i)
+    {
+        status s = sample(i);
+        tx.send<1>(s);
+    }
+    const std::string wire = out.str();
+
+    std::stringstream unused;
+    connector rx(unused);
+    rx.registerMessageHandler<1>(&onStatus);
+    rx.feed(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+    CHECK(received == frames);
+}
+
+}
+
+int main()
+{
+    testEncoding();
+    testConnector();
+
+    return 0;
+}